@@ -0,0 +1,188 @@
+//========================================================//
+//  addrmap.c                                             //
+//  Source file for the Address Map                       //
+//                                                        //
+//  Open addressing table from (asid, region) to region   //
+//  id, with a bitmap of the ids in use                   //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "addrmap.h"
+
+#define ADDR_MIN_REGION_BITS 12   // Caps the ids at 2^20
+#define ADDR_NO_ID 0xffffffff
+
+//------------------------------------//
+//       Address Map Structures       //
+//------------------------------------//
+
+typedef struct {
+  uint64_t region;      // Address bits above regionBits
+  uint32_t asid;
+  uint32_t id;          // ADDR_NO_ID for an empty slot
+} addr_slot;
+
+struct addr_map {
+  uint32_t regionBits;
+  uint32_t ids;         // Region ids a 32-bit address holds
+  uint32_t nextFree;    // No id above it is free
+  uint64_t *used;       // Bitmap of the ids given out
+
+  addr_slot *slots;
+  size_t   capacity;    // Power of two
+  size_t   count;
+  pthread_mutex_t lock;
+};
+
+//------------------------------------//
+//       Address Map Helpers          //
+//------------------------------------//
+
+static size_t
+slot_hash(uint64_t region, uint32_t asid)
+{
+  uint64_t h = (region ^ ((uint64_t)asid << 40)) * 0x9e3779b97f4a7c15ull;
+  return h >> 32;
+}
+
+static addr_slot *
+find_slot(addr_slot *slots, size_t capacity, uint64_t region, uint32_t asid)
+{
+  size_t i = slot_hash(region, asid) & (capacity - 1);
+  while (slots[i].id != ADDR_NO_ID &&
+         (slots[i].region != region || slots[i].asid != asid)) {
+    i = (i + 1) & (capacity - 1);
+  }
+  return &slots[i];
+}
+
+static addr_slot *
+alloc_slots(size_t capacity)
+{
+  addr_slot *slots = (addr_slot *)malloc(capacity * sizeof(addr_slot));
+  if (!slots) {
+    fprintf(stderr, "Unable to allocate %lu address regions\n", capacity);
+    exit(1);
+  }
+  for (size_t i = 0; i < capacity; i++) {
+    slots[i].id = ADDR_NO_ID;
+  }
+  return slots;
+}
+
+// Double the table once it is half full
+//
+static void
+grow(addr_map *map)
+{
+  size_t capacity = map->capacity * 2;
+  addr_slot *slots = alloc_slots(capacity);
+  for (size_t i = 0; i < map->capacity; i++) {
+    addr_slot *s = &map->slots[i];
+    if (s->id != ADDR_NO_ID) {
+      *find_slot(slots, capacity, s->region, s->asid) = *s;
+    }
+  }
+  free(map->slots);
+  map->slots = slots;
+  map->capacity = capacity;
+}
+
+static int
+id_used(const addr_map *map, uint32_t id)
+{
+  return (map->used[id >> 6] >> (id & 63)) & 1;
+}
+
+// Pick the id of a new region
+//
+static uint32_t
+take_id(addr_map *map, uint64_t region, uint32_t asid)
+{
+  uint32_t id = (uint32_t)region;
+  if (asid != 0 || region >= map->ids || id_used(map, id)) {
+    while (map->nextFree != ADDR_NO_ID && id_used(map, map->nextFree)) {
+      map->nextFree--;
+    }
+    if (map->nextFree == ADDR_NO_ID) {
+      fprintf(stderr, "Input Error the trace touches more than %u regions "
+              "of 2^%u bytes\n", map->ids, map->regionBits);
+      exit(1);
+    }
+    id = map->nextFree;
+  }
+  map->used[id >> 6] |= (uint64_t)1 << (id & 63);
+  return id;
+}
+
+//------------------------------------//
+//      Address Map Functions         //
+//------------------------------------//
+
+addr_map *
+addr_map_create(uint32_t regionBits)
+{
+  if (regionBits < ADDR_MIN_REGION_BITS) {
+    regionBits = ADDR_MIN_REGION_BITS;
+  }
+  if (regionBits > 32) {
+    regionBits = 32;
+  }
+
+  addr_map *map = (addr_map *)calloc(1, sizeof(addr_map));
+  map->regionBits = regionBits;
+  map->ids = (uint32_t)((uint64_t)1 << (32 - regionBits));
+  map->nextFree = map->ids - 1;
+  map->used = (uint64_t *)calloc((map->ids + 63) / 64, sizeof(uint64_t));
+  map->capacity = 64;
+  map->slots = alloc_slots(map->capacity);
+  pthread_mutex_init(&map->lock, NULL);
+  return map;
+}
+
+void
+addr_map_free(addr_map *map)
+{
+  pthread_mutex_destroy(&map->lock);
+  free(map->used);
+  free(map->slots);
+  free(map);
+}
+
+uint32_t
+addr_map_bits(const addr_map *map)
+{
+  return map->regionBits;
+}
+
+uint32_t
+addr_map_region(addr_map *map, uint32_t asid, uint64_t addr)
+{
+  uint64_t region = addr >> map->regionBits;
+  pthread_mutex_lock(&map->lock);
+  addr_slot *s = find_slot(map->slots, map->capacity, region, asid);
+  uint32_t id = s->id;
+  if (id == ADDR_NO_ID) {
+    id = take_id(map, region, asid);
+    s->region = region;
+    s->asid = asid;
+    s->id = id;
+    if (++map->count * 2 > map->capacity) {
+      grow(map);
+    }
+  }
+  pthread_mutex_unlock(&map->lock);
+  return id;
+}
+
+uint32_t
+addr_map_compress(addr_map *map, uint32_t asid, uint64_t addr)
+{
+  uint64_t base = (uint64_t)addr_map_region(map, asid, addr) <<
+                  map->regionBits;
+  uint64_t offset = addr & (((uint64_t)1 << map->regionBits) - 1);
+  return (uint32_t)(base | offset);
+}
@@ -0,0 +1,55 @@
+//========================================================//
+//  addrmap.h                                             //
+//  Header file for the Address Map                       //
+//                                                        //
+//  Compresses 64-bit addresses and address space ids     //
+//  into the 32-bit addresses the caches are indexed      //
+//  and tagged with                                       //
+//========================================================//
+
+#ifndef ADDRMAP_H
+#define ADDRMAP_H
+
+#include <stdint.h>
+
+//
+// The address space is cut into regions of 2^regionBits bytes and every
+// (asid, region) pair touched gets a region id. A compressed address is
+// the region id followed by the low regionBits bits of the address, so
+// tags keep 32 bits per line and the tag of a line stands for its whole
+// 64-bit address and asid. As long as regionBits covers the block offset
+// and set index of every level, the sets, hits and misses are the same as
+// with full addresses. Only prefetches that cross a region boundary land
+// in another region.
+//
+// Regions of asid 0 below 4 GB keep their own number as id when it is
+// free, so 32-bit traces map onto themselves. The others take the highest
+// free id. A trace can touch at most 2^(32 - regionBits) regions.
+//
+
+struct addr_map;
+
+//------------------------------------//
+//   Address Map Function Prototypes  //
+//------------------------------------//
+
+// Create a map of regions of 2^'regionBits' bytes, at most 32
+//
+struct addr_map *addr_map_create(uint32_t regionBits);
+
+void addr_map_free(struct addr_map *map);
+
+uint32_t addr_map_bits(const struct addr_map *map);
+
+// Return the id of the region holding 'addr' in the address space 'asid',
+// giving it one if it has none. Safe to call from several threads
+// Exits with a message when every id is taken
+//
+uint32_t addr_map_region(struct addr_map *map, uint32_t asid, uint64_t addr);
+
+// Return the compressed address of 'addr' in the address space 'asid'
+//
+uint32_t addr_map_compress(struct addr_map *map, uint32_t asid,
+                           uint64_t addr);
+
+#endif
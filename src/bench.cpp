@@ -0,0 +1,494 @@
+//========================================================//
+//  bench.cpp                                             //
+//  Benchmark Driver for the Simulator                    //
+//                                                        //
+//  Decode and simulate throughput of the preset          //
+//  hierarchies, checked against correctOutput and        //
+//  written as JSON                                       //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "cache.h"
+#include "trace.h"
+#include "synth.h"
+
+using namespace std;
+
+#define SYNTH_ACCESSES  (1 << 23)
+#define READ_BLOCK      (1 << 16)
+
+//------------------------------------//
+//          Bench Settings            //
+//------------------------------------//
+
+const char *tracePath = "../traces/mat_20M.bz2";
+const char *traceLabel = NULL;    // Name of the trace, from its path if NULL
+const char *expectDir = "../correctOutput";
+const char *jsonPath = "bench.json";
+const char *baselinePath = NULL;  // Earlier JSON to compare against
+double tolerance = 10.0;  // Slowdown in percent counted as a regression
+int rounds = 3;           // Simulations per preset, the fastest counts
+int generic = FALSE;      // Time the generic access path of every preset
+
+//
+// The hierarchies of buildAndTest.sh, as named in correctOutput
+//
+typedef struct {
+  const char *name;
+  level_config icache, dcache, l2cache;
+  uint32_t blocksize;
+  uint32_t memspeed;
+  uint32_t inclusive;
+} bench_preset;
+
+static const bench_preset presets[] = {
+  { "intel", { 256, 1, 2 }, { 256, 1, 2 }, { 512, 8, 10 }, 64, 100, TRUE },
+  { "arm", { 128, 2, 2 }, { 128, 4, 2 }, { 256, 8, 10 }, 64, 100, FALSE },
+  { "mips", { 128, 2, 2 }, { 64, 4, 2 }, { 128, 8, 50 }, 128, 100, TRUE },
+  { "alpha", { 512, 2, 2 }, { 256, 4, 2 }, { 16384, 8, 50 }, 64, 100, TRUE },
+  { "btcminer", { 0, 0, 0 }, { 0, 0, 0 }, { 8, 1, 50 }, 128, 100, FALSE },
+};
+#define NUM_PRESETS (sizeof(presets) / sizeof(presets[0]))
+
+typedef struct {
+  string name;
+  string source;        // "trace" or "synthetic"
+  vector<mem_access> accesses;
+  double decodeSeconds; // Reading and parsing the trace, 0 if generated
+} bench_workload;
+
+typedef struct {
+  string workload;
+  string preset;
+  int kernel;           // Ran a specialized kernel
+  double seconds;       // Fastest simulation
+  double maps;          // Million accesses per second
+  int checked;          // Statistics lines compared with correctOutput
+  int mismatches;
+  double baseline;      // Million accesses per second before, 0 if unknown
+} bench_result;
+
+//------------------------------------//
+//          Bench Helpers             //
+//------------------------------------//
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+usage()
+{
+  fprintf(stderr,"Usage: cachebench <options>\n");
+  fprintf(stderr,"  --trace=<path>      Trace to time and check, - for stdin "
+      "(%s)\n", tracePath);
+  fprintf(stderr,"  --name=<trace>      Name of the trace in correctOutput, "
+      "from its path\n");
+  fprintf(stderr,"  --expect=<dir>      Expected outputs, <dir>/<preset>/"
+      "<trace>.txt (%s)\n", expectDir);
+  fprintf(stderr,"  --json=<path>       Results file (%s)\n", jsonPath);
+  fprintf(stderr,"  --baseline=<path>   Results of an earlier run, slower "
+      "simulations fail\n");
+  fprintf(stderr,"  --tolerance=<pct>   Slowdown allowed over the baseline "
+      "(%.0f)\n", tolerance);
+  fprintf(stderr,"  --rounds=<n>        Simulations per preset, the fastest "
+      "counts (%d)\n", rounds);
+  fprintf(stderr,"  --generic           Time the generic path, no "
+      "specialized kernels\n");
+}
+
+// Return the trace name correctOutput files use, 'path' without its
+// directory and compression suffix
+//
+static string
+traceName(const char *path)
+{
+  const char *base = strrchr(path, '/');
+  string name = base ? base + 1 : path;
+  const char *suffixes[] = { ".bz2", ".gz", ".zst" };
+  for (int i = 0; i < 3; i++) {
+    size_t n = strlen(suffixes[i]);
+    if (name.size() > n && !name.compare(name.size() - n, n, suffixes[i])) {
+      name.erase(name.size() - n);
+    }
+  }
+  return name;
+}
+
+static void
+initPreset(cache_sim *sim, const bench_preset *p)
+{
+  cache_config c;
+  memset(&c, 0, sizeof(c));
+  c.icache = p->icache;
+  c.dcache = p->dcache;
+  c.l2cache = p->l2cache;
+  c.l2policy = p->inclusive ? L2_INCLUSIVE : L2_NINE;
+  c.blocksize = p->blocksize;
+  c.memspeed = p->memspeed;
+  c.generic = generic;
+  init_cache(sim, &c);
+}
+
+//------------------------------------//
+//            Workloads               //
+//------------------------------------//
+
+// Read the whole trace at 'path' into memory, timing the decode phase
+//
+static void
+loadTrace(bench_workload *w, const char *path)
+{
+  trace t;
+  int isStdin = !strcmp(path, "-");
+  if (!trace_open(&t, isStdin ? NULL : path)) {
+    perror(path);
+    exit(1);
+  }
+  w->name = traceLabel ? traceLabel : isStdin ? "stdin" : traceName(path);
+  w->source = "trace";
+
+  double start = now();
+  size_t n;
+  do {
+    size_t at = w->accesses.size();
+    w->accesses.resize(at + READ_BLOCK);
+    n = trace_read(&t, &w->accesses[at], READ_BLOCK);
+    w->accesses.resize(at + n);
+  } while (n);
+  w->decodeSeconds = now() - start;
+  trace_close(&t);
+}
+
+// Generate SYNTH_ACCESSES accesses of 'pattern' (synth.h) over 64 MB. The
+// "mixed" workload fetches two thirds of its accesses from a 16 KB loop,
+// the rest are random reads and writes of a 1 MB working set
+//
+static void
+synthesize(bench_workload *w, int pattern)
+{
+  synth_config c;
+  synth_defaults(&c);
+  if (pattern < 0) {
+    w->name = "mixed";
+    c.pattern = SYNTH_RANDOM;
+    c.footprint = 1 << 20;
+    c.ifrac = 2.0 / 3;
+    c.wfrac = 0.25;
+  } else {
+    w->name = synth_name(pattern);
+    c.pattern = pattern;
+  }
+  w->source = "synthetic";
+  w->decodeSeconds = 0;
+  w->accesses.resize(SYNTH_ACCESSES);
+
+  synth_gen *g = synth_create(&c);
+  synth_fill(g, w->accesses.data(), SYNTH_ACCESSES);
+  synth_free(g);
+}
+
+//------------------------------------//
+//        Statistics Check            //
+//------------------------------------//
+
+static void
+addCount(map<string, string> *stats, const string &label, uint64_t value)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%lu", value);
+  (*stats)[label] = buf;
+}
+
+static void
+addStat(map<string, string> *stats, const string &label, const char *fmt,
+        double value)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), fmt, value);
+  (*stats)[label] = buf;
+}
+
+static void
+addLevelStats(map<string, string> *stats, const cache_level *l,
+              const char *name)
+{
+  if (!l->sets) {
+    return;
+  }
+  string n = name;
+  addCount(stats, "total " + n + " accesses", l->refs);
+  addCount(stats, "total " + n + " misses", l->misses);
+  addCount(stats, "total " + n + " penalties", l->penalties);
+  if (l->refs > 0) {
+    addStat(stats, n + " miss rate", "%.2f%%", 100.0 * l->misses / l->refs);
+    addStat(stats, "avg " + n + " access time", "%.2f cycles",
+            (double)(l->penalties + l->refs * l->hitTime) / l->refs);
+  } else {
+    (*stats)[n + " miss rate"] = "-";
+    (*stats)["avg " + n + " access time"] = "-";
+  }
+}
+
+// The statistics of 'sim' by their label in the report of the simulator
+//
+static map<string, string>
+simStats(const cache_sim *sim)
+{
+  map<string, string> stats;
+  addLevelStats(&stats, &sim->icache, "I-cache");
+  addLevelStats(&stats, &sim->dcache, "D-cache");
+  addLevelStats(&stats, &sim->l2cache, "L2-cache");
+  addCount(&stats, "Total Memory accesses", sim->totalRefs);
+  addCount(&stats, "Total Memory penalties", sim->totalPenalties);
+  if (sim->totalRefs > 0) {
+    addStat(&stats, "avg Memory access time", "%.2f cycles",
+            (double)sim->totalPenalties / sim->totalRefs);
+  }
+  return stats;
+}
+
+// Compare every statistic of the expected report 'path' with 'sim'
+// Returns the number of mismatches, sets 'checked' to the lines compared,
+// 0 if there is no expected report
+//
+static int
+checkStats(const cache_sim *sim, const char *path, int *checked)
+{
+  *checked = 0;
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return 0;
+  }
+
+  map<string, string> stats = simStats(sim);
+  char line[256];
+  int inStats = FALSE, mismatches = 0;
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (!strcmp(line, "Cache Statistics:")) {
+      inStats = TRUE;
+      continue;
+    }
+    char *colon = strchr(line, ':');
+    if (!inStats || !colon) {
+      continue;
+    }
+    *colon = '\0';
+    string label = line + strspn(line, " ");
+    string value = colon + 1 + strspn(colon + 1, " ");
+    map<string, string>::iterator it = stats.find(label);
+    (*checked)++;
+    if (it == stats.end() || it->second != value) {
+      fprintf(stderr, "%s: %s is %s, expected %s\n", path, label.c_str(),
+          it == stats.end() ? "missing" : it->second.c_str(), value.c_str());
+      mismatches++;
+    }
+  }
+  fclose(f);
+  return mismatches;
+}
+
+//------------------------------------//
+//         Results and JSON           //
+//------------------------------------//
+
+// Read the simulate throughput of each workload and preset from an
+// earlier results file, one result per line as writeJson() puts them
+//
+static map<string, double>
+readBaseline(const char *path)
+{
+  map<string, double> base;
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  char line[512], workload[64], preset[64];
+  double maps;
+  while (fgets(line, sizeof(line), f)) {
+    const char *w = strstr(line, "\"workload\": \"");
+    const char *p = strstr(line, "\"preset\": \"");
+    const char *m = strstr(line, "\"simulate_maps\": ");
+    if (w && p && m && sscanf(w + 13, "%63[^\"]", workload) == 1 &&
+        sscanf(p + 11, "%63[^\"]", preset) == 1 &&
+        sscanf(m + 17, "%lf", &maps) == 1) {
+      base[string(workload) + "/" + preset] = maps;
+    }
+  }
+  fclose(f);
+  return base;
+}
+
+static int
+regressed(const bench_result *r)
+{
+  return r->baseline > 0 && r->maps < r->baseline * (1 - tolerance / 100);
+}
+
+static void
+writeJson(const char *path, const vector<bench_workload> &workloads,
+          const vector<bench_result> &results)
+{
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    exit(1);
+  }
+  fprintf(out, "{\n  \"generic\": %s,\n  \"rounds\": %d,\n",
+      generic ? "true" : "false", rounds);
+  fprintf(out, "  \"workloads\": [\n");
+  for (size_t i = 0; i < workloads.size(); i++) {
+    const bench_workload *w = &workloads[i];
+    fprintf(out, "    {\"name\": \"%s\", \"source\": \"%s\", "
+        "\"accesses\": %lu, \"decode_seconds\": %.4f, \"decode_maps\": %.2f}%s\n",
+        w->name.c_str(), w->source.c_str(), w->accesses.size(),
+        w->decodeSeconds,
+        w->decodeSeconds > 0 ? w->accesses.size() / w->decodeSeconds / 1e6 : 0,
+        i + 1 < workloads.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const bench_result *r = &results[i];
+    fprintf(out, "    {\"workload\": \"%s\", \"preset\": \"%s\", "
+        "\"kernel\": %s, \"simulate_seconds\": %.4f, \"simulate_maps\": %.2f, "
+        "\"stats_checked\": %d, \"stats_mismatches\": %d, "
+        "\"baseline_maps\": %.2f, \"regression\": %s}%s\n",
+        r->workload.c_str(), r->preset.c_str(), r->kernel ? "true" : "false",
+        r->seconds, r->maps, r->checked, r->mismatches, r->baseline,
+        regressed(r) ? "true" : "false", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+}
+
+//------------------------------------//
+//             Bench Run              //
+//------------------------------------//
+
+static bench_result
+runPreset(const bench_workload *w, const bench_preset *p)
+{
+  bench_result r;
+  r.workload = w->name;
+  r.preset = p->name;
+  r.seconds = 1e30;
+
+  cache_sim sim;
+  for (int i = 0; i < rounds; i++) {
+    initPreset(&sim, p);
+    double start = now();
+    cache_access_batch(&sim, w->accesses.data(), w->accesses.size());
+    double t = now() - start;
+    r.seconds = t < r.seconds ? t : r.seconds;
+    if (i + 1 < rounds) {
+      free_cache(&sim);
+    }
+  }
+  r.kernel = sim.kernel != NULL;
+  r.maps = w->accesses.size() / r.seconds / 1e6;
+  r.baseline = 0;
+  r.checked = 0;
+  r.mismatches = 0;
+  if (w->source == "trace") {
+    string expect = string(expectDir) + "/" + p->name + "/" + w->name + ".txt";
+    r.mismatches = checkStats(&sim, expect.c_str(), &r.checked);
+  }
+  free_cache(&sim);
+  return r;
+}
+
+int
+main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i],"--trace=",8)) {
+      tracePath = argv[i]+8;
+    } else if (!strncmp(argv[i],"--name=",7)) {
+      traceLabel = argv[i]+7;
+    } else if (!strncmp(argv[i],"--expect=",9)) {
+      expectDir = argv[i]+9;
+    } else if (!strncmp(argv[i],"--json=",7)) {
+      jsonPath = argv[i]+7;
+    } else if (!strncmp(argv[i],"--baseline=",11)) {
+      baselinePath = argv[i]+11;
+    } else if (!strncmp(argv[i],"--tolerance=",12)) {
+      sscanf(argv[i]+12,"%lf", &tolerance);
+    } else if (!strncmp(argv[i],"--rounds=",9) &&
+               sscanf(argv[i]+9,"%d", &rounds) == 1 && rounds > 0) {
+      continue;
+    } else if (!strcmp(argv[i],"--generic")) {
+      generic = TRUE;
+    } else {
+      usage();
+      exit(!!strcmp(argv[i],"--help"));
+    }
+  }
+
+  vector<bench_workload> workloads(2 + SYNTH_PATTERNS);
+  loadTrace(&workloads[0], tracePath);
+  for (int p = 0; p < SYNTH_PATTERNS; p++) {
+    synthesize(&workloads[1 + p], p);
+  }
+  synthesize(&workloads[1 + SYNTH_PATTERNS], -1);
+
+  map<string, double> baseline;
+  if (baselinePath) {
+    baseline = readBaseline(baselinePath);
+  }
+
+  printf("%-12s %10s %10s\n", "Workload", "Accesses", "Decode Ma/s");
+  for (size_t i = 0; i < workloads.size(); i++) {
+    const bench_workload *w = &workloads[i];
+    if (w->decodeSeconds > 0) {
+      printf("%-12s %10lu %10.2f\n", w->name.c_str(), w->accesses.size(),
+          w->accesses.size() / w->decodeSeconds / 1e6);
+    } else {
+      printf("%-12s %10lu %10s\n", w->name.c_str(), w->accesses.size(), "-");
+    }
+  }
+  printf("\n%-12s %-9s %-7s %10s %10s %8s\n", "Workload", "Preset", "Kernel",
+      "Sim Ma/s", "Baseline", "Stats");
+
+  vector<bench_result> results;
+  int failures = 0;
+  for (size_t i = 0; i < workloads.size(); i++) {
+    for (size_t p = 0; p < NUM_PRESETS; p++) {
+      bench_result r = runPreset(&workloads[i], &presets[p]);
+      map<string, double>::iterator b = baseline.find(r.workload + "/" +
+                                                      r.preset);
+      if (b != baseline.end()) {
+        r.baseline = b->second;
+      }
+
+      char stats[32] = "-";
+      if (r.checked) {
+        snprintf(stats, sizeof(stats), "%s", r.mismatches ? "DIFF" : "OK");
+      }
+      printf("%-12s %-9s %-7s %10.2f %10.2f %8s%s\n", r.workload.c_str(),
+          r.preset.c_str(), r.kernel ? "yes" : "no", r.maps, r.baseline,
+          stats, regressed(&r) ? "  SLOWER" : "");
+      failures += r.mismatches > 0 || regressed(&r);
+      results.push_back(r);
+    }
+  }
+
+  writeJson(jsonPath, workloads, results);
+  if (failures) {
+    fprintf(stderr, "%d results differ from correctOutput or regressed\n",
+        failures);
+    return 1;
+  }
+  return 0;
+}
@@ -55,33 +55,33 @@ OPTS=''
 for f in $FILES
 do
   TESTRESULT="$(basename $f).log"
-  bunzip2 -kc $f | $OPTS ./cache --icache=$INTEL_I --dcache=$INTEL_D --l2cache=$INTEL_L2 --blocksize=$INTEL_BLOCK --memspeed=$INTEL_MEM --inclusive > "$INTEL_DIR/$TESTRESULT"
+  $OPTS ./cache --icache=$INTEL_I --dcache=$INTEL_D --l2cache=$INTEL_L2 --blocksize=$INTEL_BLOCK --memspeed=$INTEL_MEM --inclusive $f > "$INTEL_DIR/$TESTRESULT"
 done
 
 # # run experiments on ARM
 for f in $FILES
 do
   TESTRESULT="$(basename $f).log"
-  bunzip2 -kc $f | $OPTS ./cache --icache=$ARM_I --dcache=$ARM_D --l2cache=$ARM_L2 --blocksize=$ARM_BLOCK --memspeed=$ARM_MEM > "$ARM_DIR/$TESTRESULT"
+  $OPTS ./cache --icache=$ARM_I --dcache=$ARM_D --l2cache=$ARM_L2 --blocksize=$ARM_BLOCK --memspeed=$ARM_MEM $f > "$ARM_DIR/$TESTRESULT"
 done
 
 # run experiments on MIPS
 for f in $FILES
 do
   TESTRESULT="$(basename $f).log"
-  bunzip2 -kc $f | $OPTS ./cache --icache=$MIPS_I --dcache=$MIPS_D --l2cache=$MIPS_L2 --blocksize=$MIPS_BLOCK --memspeed=$MIPS_MEM --inclusive > "$MIPS_DIR/$TESTRESULT"
+  $OPTS ./cache --icache=$MIPS_I --dcache=$MIPS_D --l2cache=$MIPS_L2 --blocksize=$MIPS_BLOCK --memspeed=$MIPS_MEM --inclusive $f > "$MIPS_DIR/$TESTRESULT"
 done
 
 # run experiments on Alpha
 for f in $FILES
 do
   TESTRESULT="$(basename $f).log"
-  bunzip2 -kc $f | $OPTS ./cache --icache=$ALPHA_I --dcache=$ALPHA_D --l2cache=$ALPHA_L2 --blocksize=$ALPHA_BLOCK --memspeed=$ALPHA_MEM --inclusive > "$ALPHA_DIR/$TESTRESULT"
+  $OPTS ./cache --icache=$ALPHA_I --dcache=$ALPHA_D --l2cache=$ALPHA_L2 --blocksize=$ALPHA_BLOCK --memspeed=$ALPHA_MEM --inclusive $f > "$ALPHA_DIR/$TESTRESULT"
 done
 
 # run experiments on bitcoin miner
 for f in $FILES
 do
   TESTRESULT="$(basename $f).log"
-  bunzip2 -kc $f | $OPTS ./cache --icache=$BTCMINER_I --dcache=$BTCMINER_D --l2cache=$BTCMINER_L2 --blocksize=$BTCMINER_BLOCK --memspeed=$BTCMINER_MEM > "$BTCMINER_DIR/$TESTRESULT"
+  $OPTS ./cache --icache=$BTCMINER_I --dcache=$BTCMINER_D --l2cache=$BTCMINER_L2 --blocksize=$BTCMINER_BLOCK --memspeed=$BTCMINER_MEM $f > "$BTCMINER_DIR/$TESTRESULT"
 done
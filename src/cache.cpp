@@ -6,13 +6,18 @@
 //  described in the README                               //
 //========================================================//
 
-#include <map>
-#include <vector>
-#include <utility>
-#include <iostream>
-#include <iomanip>
+#include <stdio.h>
+#include <string.h>
 #include "cache.h"
 #include "utils.h"
+#include "fixedcache.h"
+#include "tagsimd.h"
+#include "replace.h"
+#include "multicore.h"
+#include "sample.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "timing.h"
 
 using namespace std;
 const char *studentName = "Hou Wang";
@@ -21,381 +26,1159 @@ const char *email       = "how038@eng.ucsd.edu";
 const uint64_t ADDRESS_BITS = 32;
 
 //------------------------------------//
-//        Cache Configuration         //
+//          Cache Functions           //
 //------------------------------------//
 
-uint32_t icacheSets;     // Number of sets in the I$
-uint32_t icacheAssoc;    // Associativity of the I$
-uint32_t icacheHitTime;  // Hit Time of the I$
-
-uint32_t dcacheSets;     // Number of sets in the D$
-uint32_t dcacheAssoc;    // Associativity of the D$
-uint32_t dcacheHitTime;  // Hit Time of the D$
-
-uint32_t l2cacheSets;    // Number of sets in the L2$
-uint32_t l2cacheAssoc;   // Associativity of the L2$
-uint32_t l2cacheHitTime; // Hit Time of the L2$
-uint32_t inclusive;      // Indicates if the L2 is inclusive
-
-uint32_t blocksize;      // Block/Line size
-uint32_t memspeed;       // Latency of Main Memory
-
 //------------------------------------//
-//          Cache Statistics          //
+//      Cache getter Functions        //
 //------------------------------------//
 
-uint64_t icacheRefs;       // I$ references
-uint64_t icacheMisses;     // I$ misses
-uint64_t icachePenalties;  // I$ penalties
-
-uint64_t dcacheRefs;       // D$ references
-uint64_t dcacheMisses;     // D$ misses
-uint64_t dcachePenalties;  // D$ penalties
-
-uint64_t l2cacheRefs;      // L2$ references
-uint64_t l2cacheMisses;    // L2$ misses
-uint64_t l2cachePenalties; // L2$ penalties
+static const char *hashNames[HASH_COUNT] = { "modulo", "xor", "skewed" };
 
-//------------------------------------//
-//        Cache Data Structures       //
-//------------------------------------//
-
-//
-// LRU Structure:
-// blockLine -> MRU -> data 1 -> data 2 .... -> LRU
-// LRU is at the end of array
+// Return the set of 'addr' in 'level', the set of way 0 if it is skewed
 //
-uint64_t blockOffsetBits;
+static inline uint32_t
+getIndex(cache_sim *sim, cache_level *level, uint32_t addr)
+{
+  uint32_t mask = (1 << level->indexBits) - 1;
+  uint32_t line = addr >> sim->blockOffsetBits;
+  // Lines have at most 30 bits, a fold of 31 leaves the modulo
+  return (line ^ (line >> level->fold)) & mask;
+}
 
-uint64_t icacheSize; // I$ size
-uint32_t iIndexBits;
-uint32_t iTagBits;
-map<uint32_t, vector<uint32_t>> icache;
+// Return the set of 'way' of the skewed 'level' for the line 'line'
+//
+static inline uint32_t
+skewIndex(const cache_level *level, uint32_t line, uint32_t way)
+{
+  uint32_t mask = (1 << level->indexBits) - 1;
+  uint32_t high = (line >> level->indexBits) * level->skew[way];
+  return (line ^ (uint32_t)(((uint64_t)high << level->indexBits) >> 32)) &
+         mask;
+}
 
-uint64_t dcacheSize; // D$ size
-uint32_t dIndexBits;
-uint32_t dTagBits;
-map<uint32_t, vector<uint32_t>> dcache;
+static inline uint32_t
+getTag(cache_level *level, uint32_t addr)
+{
+  return addr & level->tagMask;
+}
 
-uint64_t l2cacheSize; // L2$ size
-uint32_t l2IndexBits;
-uint32_t l2TagBits;
-map<uint32_t, vector<uint32_t>> l2cache;
+// Return the address of the line held by 'entry' in 'set' of 'level'
+//
+static inline uint32_t
+getAddr(cache_sim *sim, cache_level *level, uint32_t entry, uint32_t set)
+{
+  return (entry >> sim->blockOffsetBits << sim->blockOffsetBits) |
+         ((set << sim->blockOffsetBits) & ~level->tagMask);
+}
 
 //------------------------------------//
-//          Cache Functions           //
+//      Cache Helper Functions        //
 //------------------------------------//
 
-//------------------------------------//
-//      Cache getter Functions        //
-//------------------------------------//
+// Look for 'tag' in the skewed 'level'
+// Returns the way holding it in the high half and the set of that way in
+// the low half, or assoc and 'set' if it is not present
+//
+static __attribute__((noinline)) uint64_t
+skewGet(cache_level *level, uint32_t set, uint32_t tag)
+{
+  uint32_t line = tag >> (level->tagShift - level->indexBits);
+  for (uint32_t way = 0; way < level->assoc; way++) {
+    uint32_t s = skewIndex(level, line, way);
+    uint32_t entry = level->tags[(uint64_t)s * level->assoc + way];
+    if ((entry & (level->tagMask | TAG_VALID)) == (tag | TAG_VALID)) {
+      return (uint64_t)way << 32 | s;
+    }
+  }
+  return (uint64_t)level->assoc << 32 | set;
+}
 
-uint32_t
-igetIndex(uint32_t addr)
+// Return the way of the skewed 'level' a fill of 'tag' should replace,
+// the first invalid or else the least recently used of its candidates,
+// and set *set to the set of that way
+//
+static uint32_t
+skewVictim(cache_level *level, uint32_t *set, uint32_t tag)
 {
-  uint32_t mask = (1 << iIndexBits) - 1;
-  uint32_t ans = (addr >> blockOffsetBits) & mask;
-  return ans << blockOffsetBits;
+  uint32_t line = (tag & level->tagMask) >>
+                  (level->tagShift - level->indexBits);
+  uint64_t oldest = UINT64_MAX;
+  uint32_t victim = 0;
+  for (uint32_t way = 0; way < level->assoc; way++) {
+    uint32_t s = skewIndex(level, line, way);
+    uint64_t stamp = level->repl[(uint64_t)s * level->assoc + way];
+    if (stamp < oldest) {
+      oldest = stamp;
+      victim = way;
+      *set = s;
+    }
+  }
+  return victim;
 }
 
-uint32_t
-igetTag(uint32_t addr)
+// Return the way holding 'tag' in '*set', or assoc if it is not present.
+// A hit in a skewed level sets *set to the set of the way
+//
+static inline uint32_t
+cacheGet(cache_level *level, uint32_t *set, uint32_t tag)
 {
-  uint32_t ans = addr >> (iIndexBits + blockOffsetBits);
-  return ans << (iIndexBits + blockOffsetBits);
+  uint32_t *ways = level->tags + (uint64_t)*set * level->assoc;
+  uint32_t way = tag_find(ways, level->assoc, tag | TAG_VALID,
+                          level->tagMask | TAG_VALID);
+  // The way 0 set of a skewed level only holds the lines whose hash of
+  // their way lands on it, the others are looked for one way at a time
+  if (way == level->assoc && level->skew) {
+    uint64_t found = skewGet(level, *set, tag);
+    *set = (uint32_t)found;
+    way = found >> 32;
+  }
+  return way;
 }
 
-uint32_t
-dgetIndex(uint32_t addr)
+// Return the way of the victim cache 'vc' holding the line 'tag', or assoc
+// if it is not present. Victim caches are fully associative, so they are
+// always searched with vector compares
+//
+static inline uint32_t
+victimGet(cache_level *vc, uint32_t tag)
+{
+  return tag_find_simd(vc->tags, vc->assoc, tag | TAG_VALID,
+                       vc->tagMask | TAG_VALID);
+}
+
+// Make 'way' invalid and the next victim of its set
+//
+void
+cacheInvalidateWay(cache_level *level, uint32_t set, uint32_t way)
 {
-  uint32_t mask = (1 << dIndexBits) - 1;
-  uint32_t ans = (addr >> blockOffsetBits) & mask;
-  return ans << blockOffsetBits;
+  repl_invalidate(level, set, way);
+  level->tags[(uint64_t)set * level->assoc + way] = 0;
 }
 
+// Update l1 cache to ensure the inclusive property
+// Returns the dropped entry, or 0 if 'addr' was not cached
+//
 uint32_t
-dgetTag(uint32_t addr)
+cacheInvalidate(cache_sim *sim, cache_level *level, uint32_t addr)
 {
-  uint32_t ans = addr >> (dIndexBits + blockOffsetBits);
-  return ans << (dIndexBits + blockOffsetBits);
+  if (!level->sets) {
+    return 0;
+  }
+
+  uint32_t set = getIndex(sim, level, addr);
+  uint32_t target = cacheGet(level, &set, getTag(level, addr));
+  if (target == level->assoc) {
+    // The line may have moved on to the victim cache
+    cache_level *vc = level->victim;
+    if (vc && (target = victimGet(vc, getTag(vc, addr))) < vc->assoc) {
+      uint32_t entry = vc->tags[target];
+      cacheInvalidateWay(vc, 0, target);
+      return entry;
+    }
+    return 0;
+  }
+  uint32_t entry = level->tags[(uint64_t)set * level->assoc + target];
+  cacheInvalidateWay(level, set, target);
+  return entry;
 }
 
 uint32_t
-l2getIndex(uint32_t addr)
+cache_update_line(cache_sim *sim, cache_level *level, uint32_t addr,
+                  uint32_t add, uint32_t clear)
 {
-  uint32_t mask = (1 << l2IndexBits) - 1;
-  uint32_t ans = (addr >> blockOffsetBits) & mask;
-  return ans << blockOffsetBits;
+  if (!level->sets) {
+    return 0;
+  }
+
+  uint32_t set = getIndex(sim, level, addr);
+  uint32_t way = cacheGet(level, &set, getTag(level, addr));
+  if (way == level->assoc) {
+    return 0;
+  }
+  uint32_t *entry = &level->tags[(uint64_t)set * level->assoc + way];
+  uint32_t old = *entry;
+  if (clear & TAG_VALID) {
+    cacheInvalidateWay(level, set, way);
+  } else {
+    *entry = (old | add) & ~clear;
+  }
+  return old;
 }
 
+// Insert 'tag' into 'set' replacing the policy's victim, into the set of
+// the victim way for a skewed level
+// Returns the replaced entry, which has TAG_VALID set if a line was evicted
+//
 uint32_t
-l2getTag(uint32_t addr)
+cacheAddData(cache_level *level, uint32_t set, uint32_t tag)
 {
-  uint32_t ans = addr >> (l2IndexBits + blockOffsetBits);
-  return ans << (l2IndexBits + blockOffsetBits);
+  if (level->assoc == 0) {
+    return 0;
+  }
+
+  uint32_t way = level->skew ? skewVictim(level, &set, tag)
+                             : repl_victim(level, set);
+  uint64_t base = (uint64_t)set * level->assoc;
+
+  uint32_t victim = level->tags[base + way];
+  level->tags[base + way] = tag | TAG_VALID;
+  repl_insert(level, set, way);
+  return victim;
 }
 
 //------------------------------------//
-//      Cache Helper Functions        //
+//          Cache Init Functions      //
 //------------------------------------//
 
-uint32_t
-icacheGet(uint32_t addr)
+void
+init_level(cache_sim *sim, cache_level *level, const level_config *config)
 {
-  uint32_t tag = igetTag(addr);
-  uint32_t index = igetIndex(addr);
+  memset(level, 0, sizeof(*level));
+  level->sets = config->sets;
+  level->assoc = config->assoc;
+  level->hitTime = config->hitTime;
+  level->indexBits = log2(config->sets);
+  level->tagShift = sim->blockOffsetBits + level->indexBits;
+  level->policy = config->policy;
+  level->rng = 0x9e3779b9;
 
-  vector<uint32_t> &block = icache[index];
-  int target = 0;
-  for (target = 0; target < block.size(); target++) 
-  {
-    if (block[target] == tag)
-    {
-      break;
+  if (config->hash >= HASH_COUNT) {
+    fprintf(stderr, "Invalid index hash %u\n", config->hash);
+    exit(1);
+  }
+  // Hashed levels keep the whole line address in their tags, above the
+  // flags
+  if (config->hash != HASH_MODULO && sim->blockOffsetBits < 4) {
+    fprintf(stderr, "Index hashing needs blocks of at least 16 bytes\n");
+    exit(1);
+  }
+  uint32_t keep = config->hash == HASH_MODULO ? level->tagShift
+                                              : sim->blockOffsetBits;
+  level->tagMask = keep < 32 ? ~0u << keep : 0;
+  level->fold = config->hash == HASH_XOR ? level->indexBits : 31;
+  if (config->hash == HASH_SKEWED) {
+    if (level->policy != POLICY_LRU) {
+      fprintf(stderr, "Skewed levels only support the lru policy\n");
+      exit(1);
     }
+    level->policy = POLICY_STAMP;
+  }
+
+  const char *err = repl_check(level->policy, level->assoc);
+  if (err) {
+    fprintf(stderr, "Invalid %s policy: %s\n", repl_name(level->policy), err);
+    exit(1);
+  }
+
+  uint64_t lines = ((uint64_t)1 << level->indexBits) * level->assoc;
+  if (lines == 0) {
+    return;
+  }
+
+  void *tags, *ages;
+  if (posix_memalign(&tags, 64, (lines + TAG_PAD) * sizeof(uint32_t)) ||
+      posix_memalign(&ages, 64, lines * sizeof(uint16_t))) {
+    fprintf(stderr, "Unable to allocate %lu cache lines\n", lines);
+    exit(1);
   }
+  level->tags = (uint32_t *)tags;
+  level->ages = (uint16_t *)ages;
 
-  return target;
+  memset(level->tags, 0, (lines + TAG_PAD) * sizeof(uint32_t));
+  for (uint64_t i = 0; i < lines; i++) {
+    level->ages[i] = i % level->assoc;
+  }
+
+  if (config->hash == HASH_SKEWED) {
+    level->skew = (uint32_t *)malloc(level->assoc * sizeof(uint32_t));
+    if (!level->skew) {
+      fprintf(stderr, "Unable to allocate the skew of %u ways\n",
+              level->assoc);
+      exit(1);
+    }
+    // Way 0 keeps the modulo, the others get odd multipliers from a
+    // Murmur3 finalizer of the way number
+    for (uint32_t w = 0; w < level->assoc; w++) {
+      uint32_t h = w * 0x9e3779b9;
+      h = (h ^ (h >> 16)) * 0x85ebca6b;
+      h = (h ^ (h >> 13)) * 0xc2b2ae35;
+      level->skew[w] = w ? (h ^ (h >> 16)) | 1 : 0;
+    }
+  }
+
+  if (config->prefetch != PREFETCH_NONE) {
+    if (sim->blockOffsetBits < 3) {
+      fprintf(stderr, "Prefetching needs blocks of at least 8 bytes\n");
+      exit(1);
+    }
+    level->prefetch = pf_create(config->prefetch, sim->blockOffsetBits,
+                                config->prefetchDegree,
+                                config->prefetchDistance);
+    if (!level->prefetch) {
+      fprintf(stderr, "Unable to allocate a prefetcher\n");
+      exit(1);
+    }
+  }
+
+  if (config->victimEntries) {
+    level_config vconfig;
+    memset(&vconfig, 0, sizeof(vconfig));
+    vconfig.sets = 1;
+    vconfig.assoc = config->victimEntries;
+    vconfig.hitTime = config->victimHitTime;
+    level->victim = (cache_level *)malloc(sizeof(cache_level));
+    if (!level->victim) {
+      fprintf(stderr, "Unable to allocate a victim cache\n");
+      exit(1);
+    }
+    init_level(sim, level->victim, &vconfig);
+  }
+
+  if (level->policy != POLICY_LRU) {
+    uint64_t sets = (uint64_t)1 << level->indexBits;
+    uint64_t states = level->policy == POLICY_STAMP ? lines : sets;
+    level->repl = (uint64_t *)calloc(states, sizeof(uint64_t));
+    if (!level->repl) {
+      fprintf(stderr, "Unable to allocate %lu replacement states\n", states);
+      exit(1);
+    }
+    // RRIP ways start out distant
+    if (level->policy == POLICY_SRRIP || level->policy == POLICY_BRRIP) {
+      for (uint64_t i = 0; i < sets; i++) {
+        level->repl[i] = rrpv_mask(level->assoc);
+      }
+    }
+  }
 }
 
-uint32_t
-dcacheGet(uint32_t addr)
+void
+init_cache(cache_sim *sim, const cache_config *config)
 {
-  uint32_t tag = dgetTag(addr);
-  uint32_t index = dgetIndex(addr);
+  memset(sim, 0, sizeof(*sim));
+  sim->config = *config;
 
-  vector<uint32_t> &block = dcache[index];
-  int target = 0;
-  for (target = 0; target < block.size(); target++) 
-  {
-    if (block[target] == tag)
-    {
-      break;
+  sim->blockOffsetBits = log2(config->blocksize);
+
+  // Write-through stores would put copies of L1 lines into the L2
+  if (config->l2policy == L2_EXCLUSIVE && config->writeThrough) {
+    fprintf(stderr, "An exclusive L2 needs write-back caches\n");
+    exit(1);
+  }
+
+  // The tag flags live in the low tag bits, which the block offset clears
+  if (sim->blockOffsetBits < 2) {
+    fprintf(stderr, "Block size must be at least 4 bytes\n");
+    exit(1);
+  }
+
+  // A unified L1 is the D$, the I$ config is not used
+  if (config->unified) {
+    memset(&sim->config.icache, 0, sizeof(level_config));
+  }
+  if (config->outerLevels && !config->l2cache.sets) {
+    fprintf(stderr, "Levels below the L2 need an L2\n");
+    exit(1);
+  }
+  for (uint32_t i = 0; i < config->outerLevels; i++) {
+    if (!config->outer[i].sets) {
+      fprintf(stderr, "L%u-cache has no sets\n", i + 3);
+      exit(1);
+    }
+  }
+
+  init_level(sim, &sim->icache, &sim->config.icache);
+  init_level(sim, &sim->dcache, &config->dcache);
+  init_level(sim, &sim->l2cache, &config->l2cache);
+  for (uint32_t i = 0; i < config->outerLevels; i++) {
+    init_level(sim, &sim->outer[i], &config->outer[i]);
+  }
+  sim->ifetch = config->unified ? &sim->dcache : &sim->icache;
+  if (config->coherent) {
+    if (sim->blockOffsetBits < 4) {
+      fprintf(stderr, "Multicore runs need blocks of at least 16 bytes\n");
+      exit(1);
     }
+    sim->icache.coherent = sim->dcache.coherent = TRUE;
+  }
+
+  if (config->mrcWays) {
+    // The stack distances are taken over the modulo sets
+    if (config->l2cache.hash != HASH_MODULO) {
+      fprintf(stderr, "--mrc needs a modulo indexed L2-cache\n");
+      exit(1);
+    }
+    sim->mrc = sd_create(sim->l2cache.indexBits, sim->blockOffsetBits,
+                         config->mrcWays);
+  }
+
+  sim->kernel = fixed_kernel(sim);
+  interval_init(&sim->intervals, config->interval);
+  if (config->sampleSets) {
+    sim->sampler = sample_create(sim);
+  }
+  if (config->profile) {
+    sim->profile = profile_create(sim);
   }
+  if (config->timing) {
+    sim->timing = timing_create(sim);
+  }
+}
 
-  return target;
+static void
+free_level(cache_level *level)
+{
+  free(level->tags);
+  free(level->ages);
+  free(level->repl);
+  free(level->skew);
+  pf_free(level->prefetch);
+  if (level->victim) {
+    free_level(level->victim);
+    free(level->victim);
+  }
+  level->prefetch = NULL;
+  level->victim = NULL;
+  level->tags = NULL;
+  level->ages = NULL;
+  level->repl = NULL;
+  level->skew = NULL;
 }
 
-uint32_t
-l2cacheGet(uint32_t addr)
+void
+free_cache(cache_sim *sim)
 {
-  uint32_t tag = l2getTag(addr);
-  uint32_t index = l2getIndex(addr);
+  if (sim->stateMap) {
+    checkpoint_release(sim);
+  }
+  if (sim->profile) {
+    profile_free(sim);
+  }
+  if (sim->timing) {
+    timing_free(sim->timing);
+    sim->timing = NULL;
+  }
+  free_level(&sim->icache);
+  free_level(&sim->dcache);
+  free_level(&sim->l2cache);
+  for (uint32_t i = 0; i < MAX_OUTER_LEVELS; i++) {
+    free_level(&sim->outer[i]);
+  }
+  if (sim->mrc) {
+    sd_free(sim->mrc);
+    sim->mrc = NULL;
+  }
+  // The interval file belongs to the caller
+  sim->intervals.out = NULL;
+  if (sim->sampler) {
+    sample_free(sim->sampler);
+    sim->sampler = NULL;
+  }
+}
 
-  vector<uint32_t> &block = l2cache[index];
-  int target = 0;
-  for (target = 0; target < block.size(); target++) {
-    if (block[target] == tag)
-      break;
+uint32_t
+cache_region_bits(const cache_sim *sim)
+{
+  uint32_t bits = sim->icache.tagShift;
+  if (sim->dcache.tagShift > bits) {
+    bits = sim->dcache.tagShift;
+  }
+  if (sim->l2cache.tagShift > bits) {
+    bits = sim->l2cache.tagShift;
+  }
+  for (uint32_t i = 0; i < sim->config.outerLevels; i++) {
+    if (sim->outer[i].tagShift > bits) {
+      bits = sim->outer[i].tagShift;
+    }
   }
+  return bits;
+}
 
-  return target;
+int
+cache_hash_parse(const char *name)
+{
+  for (int h = 0; h < HASH_COUNT; h++) {
+    if (!strcmp(name, hashNames[h])) {
+      return h;
+    }
+  }
+  return -1;
 }
 
-// Update l1 cache to ensure the inclusive property
-void 
-icacheInvalidate(uint32_t addr)
+const char *
+cache_hash_name(uint32_t hash)
 {
-  uint32_t index = igetIndex(addr);
-  uint32_t tag = igetTag(addr);
-  uint32_t target = 0;
+  return hash < HASH_COUNT ? hashNames[hash] : "?";
+}
+
+//------------------------------------//
+//         Cache Access Functions     //
+//------------------------------------//
 
-  if ((target = icacheGet(addr)) < icache[index].size()) {
-    vector<uint32_t> &block = icache[index];
-    block.erase(block.begin() + target);
+// Bump 'counter' of 'set' of 'level' when the hierarchy is profiled
+//
+static inline void
+profileCount(cache_level *level, uint32_t set, int counter)
+{
+  if (level->setCounts) {
+    level->setCounts[(uint64_t)set * PROFILE_COUNTERS + counter]++;
   }
 }
 
-void 
-dcacheInvalidate(uint32_t addr)
+// Return the level below the L2 or outer level 'level', or NULL if it is
+// the last one before memory
+//
+static inline cache_level *
+nextLevel(cache_sim *sim, cache_level *level)
 {
-  uint32_t index = dgetIndex(addr);
-  uint32_t tag = dgetTag(addr);
-  uint32_t target = 0;
+  cache_level *next = level == &sim->l2cache ? sim->outer : level + 1;
+  return next < sim->outer + sim->config.outerLevels ? next : NULL;
+}
+
+static uint32_t cacheWrite(cache_sim *sim, cache_level *level,
+                           uint32_t addr);
+static uint32_t outerAccess(cache_sim *sim, cache_level *level,
+                            uint32_t addr);
+
+// Send the store to 'addr' from 'level' on to the next level
+//
+static uint32_t
+writeNext(cache_sim *sim, cache_level *level, uint32_t addr)
+{
+  level->writebacks++;
+  if (level == &sim->icache || level == &sim->dcache) {
+    return l2cache_write(sim, addr);
+  }
+  cache_level *next = nextLevel(sim, level);
+  if (next) {
+    return cacheWrite(sim, next, addr);
+  }
+  // The last private level of a core writes to the shared levels
+  return sim->core ? mc_shared_access(sim->core, addr, TRUE)
+                   : sim->config.memspeed;
+}
 
-  if ((target = dcacheGet(addr)) < dcache[index].size()) {
-    vector<uint32_t> &block = dcache[index];
-    block.erase(block.begin() + target);
+// Fetch the line of 'addr' from below the L2 or outer level 'level'
+// Return the time it takes
+//
+static inline uint32_t
+readNext(cache_sim *sim, cache_level *level, uint32_t addr)
+{
+  cache_level *next = nextLevel(sim, level);
+  if (next) {
+    return outerAccess(sim, next, addr);
   }
+  return sim->core ? mc_shared_access(sim->core, addr, FALSE)
+                   : sim->config.memspeed;
 }
 
-void
-icacheUpdate(uint32_t addr, uint32_t target)
+uint32_t
+cache_writeback(cache_sim *sim, cache_level *level, uint32_t set,
+                uint32_t entry)
 {
-  uint32_t index = igetIndex(addr);
-  uint32_t tag = igetTag(addr);
-  vector<uint32_t> &block = icache[index];
-  block.erase(block.begin() + target);
-  block.push_back(tag);
+  return writeNext(sim, level, getAddr(sim, level, entry, set));
 }
 
-void
-dcacheUpdate(uint32_t addr, uint32_t target)
+// Remember the demand line 'victim' if the prefetch fill of 'tag' evicted it
+//
+static inline void
+prefetchEvict(cache_sim *sim, cache_level *level, uint32_t set, uint32_t tag,
+              uint32_t victim)
 {
-  uint32_t index = dgetIndex(addr);
-  uint32_t tag = dgetTag(addr);
-  vector<uint32_t> &block = dcache[index];
-  block.erase(block.begin() + target);
-  block.push_back(tag);
+  if ((tag & TAG_PREFETCH) &&
+      (victim & (TAG_VALID | TAG_PREFETCH)) == TAG_VALID) {
+    pf_evict(level->prefetch,
+             getAddr(sim, level, victim, set) >> sim->blockOffsetBits);
+  }
 }
 
-void
-l2cacheUpdate(uint32_t addr, uint32_t target)
+// Drop the L1 copies of the line 'addr' evicted from an inclusive L2
+// Return TAG_DIRTY if one of them was dirty
+//
+static inline uint32_t
+backInvalidate(cache_sim *sim, uint32_t addr)
 {
-  uint32_t index = l2getIndex(addr);
-  uint32_t tag = l2getTag(addr);
-  vector<uint32_t> &block = l2cache[index];
-  block.erase(block.begin() + target);
-  block.push_back(tag);
+  cache_level *levels[] = { &sim->icache, &sim->dcache };
+  uint32_t dirty = 0;
+  for (int i = 0; i < 2; i++) {
+    uint32_t entry = cacheInvalidate(sim, levels[i], addr);
+    if (entry) {
+      levels[i]->invalidations++;
+      dirty |= entry & TAG_DIRTY;
+    }
+  }
+  return dirty;
 }
 
-void
-icacheAddData(uint32_t addr)
+// Fill 'tag' for 'addr' into 'set' of the L2 or an outer 'level' after
+// a miss
+// Return the miss penalty, including the writeback of a dirty victim
+//
+static inline uint32_t
+lowerFill(cache_sim *sim, cache_level *level, uint32_t addr, uint32_t set,
+          uint32_t tag)
 {
-  uint32_t index = igetIndex(addr);
-  uint32_t tag = igetTag(addr);
-  vector<uint32_t> &block = icache[index];
-  block.push_back(tag);
-  if (block.size() > icacheAssoc) 
+  uint32_t penalty = readNext(sim, level, addr);
+  uint32_t victim = cacheAddData(level, set, tag);
+  if (level == &sim->l2cache && sim->config.l2policy == L2_INCLUSIVE &&
+      (victim & TAG_VALID))
   {
-    block.erase(block.begin());
+    // Dirty L1 copies are written back along with the victim
+    victim |= backInvalidate(sim, getAddr(sim, level, victim, set));
+  }
+  prefetchEvict(sim, level, set, tag, victim);
+
+  if (victim & TAG_DIRTY) {
+    penalty += cache_writeback(sim, level, set, victim);
   }
+  return penalty;
 }
 
-void
-dcacheAddData(uint32_t addr)
+// Move the line 'addr' replaced in the L1 'level' into an exclusive L2,
+// with 'dirty' set if it was written. A dirty line is charged and counted
+// as the L2 write its writeback is in the other modes, a write that never
+// misses as the whole line comes with it. Clean lines move for free, as
+// clean victims are dropped for free in the other modes
+// Return the time taken by the write and the writeback of a dirty L2 victim
+//
+static uint32_t
+l2cacheInsert(cache_sim *sim, cache_level *level, uint32_t addr,
+              uint32_t dirty)
 {
-  uint32_t index = dgetIndex(addr);
-  uint32_t tag = dgetTag(addr);
-  vector<uint32_t> &block = dcache[index];
-  block.push_back(tag);
-  if (block.size() > dcacheAssoc) 
-  {
-    block.erase(block.begin());
+  cache_level *l2 = &sim->l2cache;
+  uint32_t time = 0;
+  if (dirty) {
+    level->writebacks++;
+    l2->refs++;
+    l2->writes++;
+    time = l2->hitTime;
+  }
+  uint32_t set = getIndex(sim, l2, addr);
+  uint32_t tag = getTag(l2, addr);
+  uint32_t target = cacheGet(l2, &set, tag);
+  if (target < l2->assoc) {
+    // Only an L2 prefetch or a write around the L1 leaves a copy here
+    l2->tags[(uint64_t)set * l2->assoc + target] |= dirty;
+    repl_touch(l2, set, target);
+    return time;
+  }
+  uint32_t victim = cacheAddData(l2, set, tag | dirty);
+  if (victim & TAG_DIRTY) {
+    time += cache_writeback(sim, l2, set, victim);
   }
+  return time;
 }
 
-void
-l2cacheAddData(uint32_t addr)
+static uint32_t prefetchAccess(cache_sim *sim, cache_level *level,
+                               uint32_t addr, uint32_t set, uint32_t way,
+                               uint32_t time);
+
+// Read the line 'addr' out of an exclusive L2 for an L1 fill. The line
+// leaves the L2, or comes from memory without an L2 fill if it is absent.
+// 'demand' reads are counted and train the L2 prefetcher
+// Return the access time and set *dirty to the TAG_DIRTY of the line
+//
+static uint32_t
+l2cacheTake(cache_sim *sim, uint32_t addr, int demand, uint32_t *dirty)
 {
-  uint32_t index = l2getIndex(addr);
-  uint32_t tag = l2getTag(addr);
-  vector<uint32_t> &block = l2cache[index];
-  block.push_back(tag);
-  if (block.size() > l2cacheAssoc) 
-  {
-    if(inclusive)
-    {
-      uint32_t reconstruct = block[0] | index;
-      icacheInvalidate(reconstruct);
-      dcacheInvalidate(reconstruct);
+  cache_level *l2 = &sim->l2cache;
+  uint32_t set = getIndex(sim, l2, addr);
+  if (demand) {
+    l2->refs++;
+    profileCount(l2, set, PROFILE_REFS);
+    if (sim->mrc) {
+      sd_access(sim->mrc, addr);
     }
-    block.erase(block.begin());
   }
+  uint32_t target = cacheGet(l2, &set, getTag(l2, addr));
+  uint32_t time = l2->hitTime;
+  *dirty = 0;
+  if (target == l2->assoc) {
+    uint32_t penalty = readNext(sim, l2, addr);
+    time += penalty;
+    if (demand) {
+      l2->misses++;
+      profileCount(l2, set, PROFILE_MISSES);
+      l2->penalties += penalty;
+    }
+  }
+  if (demand && l2->prefetch) {
+    uint32_t wait = prefetchAccess(sim, l2, addr, set, target, time);
+    l2->penalties += wait;
+    time += wait;
+  }
+  if (target < l2->assoc) {
+    *dirty = l2->tags[(uint64_t)set * l2->assoc + target] & TAG_DIRTY;
+    cacheInvalidateWay(l2, set, target);
+  }
+  return time;
 }
 
-//------------------------------------//
-//          Cache Init Functions      //
-//------------------------------------//
+// Fill 'tag' into 'set' of the L1 'level' once the line is fetched.
+// The replaced line moves to the victim cache, if the level has one
+// Return the time taken by the writeback of a dirty victim
+//
+static inline uint32_t
+l1cacheFill(cache_sim *sim, cache_level *level, uint32_t set, uint32_t tag)
+{
+  uint32_t victim = cacheAddData(level, set, tag);
+  prefetchEvict(sim, level, set, tag, victim);
+  if (sim->core && (victim & TAG_VALID)) {
+    // The directory hears of every eviction, dirty lines go with it
+    level->writebacks += (victim & TAG_DIRTY) != 0;
+    mc_evict(sim->core, level == &sim->icache,
+             getAddr(sim, level, victim, set), victim & TAG_DIRTY);
+    return 0;
+  }
+  cache_level *vc = level->victim;
+  if (vc && (victim & TAG_VALID)) {
+    uint32_t line = getAddr(sim, level, victim, set) | (victim & TAG_DIRTY);
+    // The victim cache sends its dirty lines on in the name of the L1
+    victim = cacheAddData(vc, 0, line);
+    set = 0;
+  }
+  if (sim->config.l2policy == L2_EXCLUSIVE && (victim & TAG_VALID)) {
+    return l2cacheInsert(sim, level, getAddr(sim, level, victim, set),
+                         victim & TAG_DIRTY);
+  }
+  if (victim & TAG_DIRTY) {
+    return cache_writeback(sim, level, set, victim);
+  }
+  return 0;
+}
 
-void
-init_cache()
+// Bring the line of 'addr' into 'set' of the L1 'level' as 'tag' after a
+// miss, from the victim cache if it holds the line, else from the L2
+// Return the miss penalty
+//
+static inline uint32_t
+l1cacheFetch(cache_sim *sim, cache_level *level, uint32_t addr, uint32_t set,
+             uint32_t tag)
+{
+  if (sim->core) {
+    // The shared levels answer at the end of the quantum
+    uint32_t write = tag & TAG_DIRTY;
+    mc_fetch(sim->core, level == &sim->icache, addr, write);
+    return l1cacheFill(sim, level, set, write ? tag : tag | TAG_SHARED);
+  }
+  cache_level *vc = level->victim;
+  if (vc) {
+    vc->refs++;
+    uint32_t way = victimGet(vc, getTag(vc, addr));
+    if (way < vc->assoc) {
+      // Swap the line with the one it replaces in the L1
+      uint32_t dirty = vc->tags[way] & TAG_DIRTY;
+      uint32_t victim = cacheAddData(level, set, tag | dirty);
+      if (victim & TAG_VALID) {
+        vc->tags[way] = getAddr(sim, level, victim, set) |
+                        (victim & (TAG_VALID | TAG_DIRTY));
+        repl_touch(vc, 0, way);
+      } else {
+        cacheInvalidateWay(vc, 0, way);
+      }
+      return vc->hitTime;
+    }
+    vc->misses++;
+  }
+  if (sim->config.l2policy == L2_EXCLUSIVE) {
+    uint32_t dirty;
+    uint32_t penalties = l2cacheTake(sim, addr, 1, &dirty);
+    return penalties + l1cacheFill(sim, level, set, tag | dirty);
+  }
+  uint32_t penalties = l2cache_access(sim, addr);
+  return penalties + l1cacheFill(sim, level, set, tag);
+}
+
+// Read 'addr' from the L2 for an L1 prefetch. These reads are not demand
+// references, so they are not counted and do not train the L2 prefetcher
+// Return the access time of the read
+//
+static uint32_t
+l2cachePrefetch(cache_sim *sim, uint32_t addr)
 {
-  // Initialize cache stats
-  icacheRefs        = 0;
-  icacheMisses      = 0;
-  icachePenalties   = 0;
-  dcacheRefs        = 0;
-  dcacheMisses      = 0;
-  dcachePenalties   = 0;
-  l2cacheRefs       = 0;
-  l2cacheMisses     = 0;
-  l2cachePenalties  = 0;
+  cache_level *l2 = &sim->l2cache;
+  uint32_t set = getIndex(sim, l2, addr);
+  uint32_t tag = getTag(l2, addr);
+  uint32_t target = cacheGet(l2, &set, tag);
+  if (target < l2->assoc) {
+    repl_touch(l2, set, target);
+    return l2->hitTime;
+  }
+  return l2->hitTime + lowerFill(sim, l2, addr, set, tag);
+}
 
-  blockOffsetBits = log2(blocksize);
+// Prefetch the line 'line' into 'level' unless it is already cached
+//
+static void
+prefetchFill(cache_sim *sim, cache_level *level, uint32_t line)
+{
+  uint32_t addr = line << sim->blockOffsetBits;
+  uint32_t set = getIndex(sim, level, addr);
+  uint32_t tag = getTag(level, addr);
+  if (cacheGet(level, &set, tag) < level->assoc) {
+    return;
+  }
+  cache_level *vc = level->victim;
+  if (vc && victimGet(vc, getTag(vc, addr)) < vc->assoc) {
+    return;
+  }
 
-  l2IndexBits = log2(l2cacheSets);
-  l2TagBits = ADDRESS_BITS - blockOffsetBits - l2IndexBits;
+  // The fill happens in the background, so its latency and the
+  // writeback of its victim only delay the accesses that need the line
+  uint32_t latency;
+  if (level == &sim->l2cache) {
+    latency = lowerFill(sim, level, addr, set, tag | TAG_PREFETCH);
+  } else if (sim->config.l2policy == L2_EXCLUSIVE) {
+    uint32_t dirty;
+    latency = l2cacheTake(sim, addr, 0, &dirty);
+    l1cacheFill(sim, level, set, tag | TAG_PREFETCH | dirty);
+  } else {
+    latency = l2cachePrefetch(sim, addr);
+    l1cacheFill(sim, level, set, tag | TAG_PREFETCH);
+  }
+  pf_issue(level->prefetch, line, latency);
+}
 
-  dIndexBits = log2(dcacheSets);
-  dTagBits = ADDRESS_BITS - blockOffsetBits - dIndexBits;
+// Train the prefetcher of 'level' on a demand access to 'addr' that took
+// 'time' and hit 'way' of 'set', or missed if 'way' is assoc, then issue
+// the prefetches it asks for
+// Return the time the access waits for a late prefetch of its line
+//
+static __attribute__((noinline)) uint32_t
+prefetchAccess(cache_sim *sim, cache_level *level, uint32_t addr,
+               uint32_t set, uint32_t way, uint32_t time)
+{
+  prefetcher *pf = level->prefetch;
+  uint32_t line = addr >> sim->blockOffsetBits;
+  uint32_t wait = 0;
+  int trigger = way == level->assoc;
+  if (trigger) {
+    pf_miss(pf, line);
+  } else {
+    uint32_t *entry = &level->tags[(uint64_t)set * level->assoc + way];
+    if (*entry & TAG_PREFETCH) {
+      *entry &= ~TAG_PREFETCH;
+      wait = pf_hit(pf, line);
+      trigger = 1;
+    }
+  }
 
-  iIndexBits = log2(icacheSets); 
-  iTagBits = ADDRESS_BITS - blockOffsetBits - iIndexBits;
+  uint32_t lines[PREFETCH_MAX_DEGREE];
+  uint32_t n = pf_train(pf, line, time + wait, trigger, lines);
+  for (uint32_t i = 0; i < n; i++) {
+    prefetchFill(sim, level, lines[i]);
+  }
+  return wait;
+}
 
+// Finish an L1 access to 'addr' that missed in 'set' of 'level'
+// Return the miss penalty
+//
+static __attribute__((noinline)) uint32_t
+l1cacheMiss(cache_sim *sim, cache_level *level, uint32_t addr, uint32_t set,
+            uint32_t tag)
+{
+  level->misses++;
+  profileCount(level, set, PROFILE_MISSES);
+  uint32_t penalties = l1cacheFetch(sim, level, addr, set, tag);
+  level->penalties += penalties;
+  if (level->prefetch) {
+    prefetchAccess(sim, level, addr, set, level->assoc,
+                   level->hitTime + penalties);
+  }
+  return penalties;
 }
 
-// Perform a memory access through the icache interface for the address 'addr'
+// Perform a memory access through the L1 'level' for the address 'addr',
+// which maps to 'set' of the level
 // Return the access time for the memory operation
 //
-uint32_t
-icache_access(uint32_t addr)
+static inline uint32_t
+l1cache_access(cache_sim *sim, cache_level *level, uint32_t addr,
+               uint32_t set)
 {
-  if (icacheSets == 0)
+  if (level->sets == 0)
   {
-    return l2cache_access(addr);
+    return l2cache_access(sim, addr);
   }
-  icacheRefs++;
+  level->refs++;
+  profileCount(level, set, PROFILE_REFS);
+  uint32_t tag = getTag(level, addr);
   uint32_t target = 0;
-  uint32_t index = igetIndex(addr);
-  if ((target = icacheGet(addr)) < icache[index].size()) {
-    icacheUpdate(addr, target);
-    return icacheHitTime;
+  if ((target = cacheGet(level, &set, tag)) < level->assoc) {
+    repl_touch(level, set, target);
+    if (level->prefetch) {
+      uint32_t wait = prefetchAccess(sim, level, addr, set, target,
+                                     level->hitTime);
+      level->penalties += wait;
+      return level->hitTime + wait;
+    }
+    return level->hitTime;
   }
 
-  // if tag is not found in I$
-  icacheMisses++;
-  uint32_t penalties = l2cache_access(addr);
-  icacheAddData(addr);
-  icachePenalties += penalties;
-  return icacheHitTime + penalties;
+  // if tag is not found in L1
+  return level->hitTime + l1cacheMiss(sim, level, addr, set, tag);
+}
+
+// Perform a store through 'level' for the address 'addr'
+// Return the access time for the memory operation
+//
+static uint32_t
+cacheWrite(cache_sim *sim, cache_level *level, uint32_t addr)
+{
+  const cache_config *c = &sim->config;
+  level->refs++;
+  level->writes++;
+  uint32_t set = getIndex(sim, level, addr);
+  uint32_t tag = getTag(level, addr);
+  profileCount(level, set, PROFILE_REFS);
+  uint32_t target = cacheGet(level, &set, tag);
+  uint32_t penalties = 0;
+
+  if (target < level->assoc) {
+    repl_touch(level, set, target);
+    if (level->prefetch) {
+      penalties = prefetchAccess(sim, level, addr, set, target,
+                                 level->hitTime);
+    }
+    uint32_t *entry = &level->tags[(uint64_t)set * level->assoc + target];
+    if (c->writeThrough) {
+      penalties += writeNext(sim, level, addr);
+    } else if (*entry & TAG_SHARED) {
+      *entry = (*entry & ~TAG_SHARED) | TAG_DIRTY;
+      mc_upgrade(sim->core, addr);
+    } else {
+      *entry |= TAG_DIRTY;
+    }
+  } else {
+    level->misses++;
+    profileCount(level, set, PROFILE_MISSES);
+    if (c->noWriteAllocate) {
+      penalties = writeNext(sim, level, addr);
+    } else {
+      // Fetch the line as for a read, then write it
+      uint32_t dirty = c->writeThrough ? 0 : TAG_DIRTY;
+      if (level != &sim->icache && level != &sim->dcache) {
+        penalties = lowerFill(sim, level, addr, set, tag | dirty);
+      } else {
+        penalties = l1cacheFetch(sim, level, addr, set, tag | dirty);
+      }
+      if (c->writeThrough) {
+        penalties += writeNext(sim, level, addr);
+      }
+    }
+    if (level->prefetch) {
+      prefetchAccess(sim, level, addr, set, level->assoc,
+                     level->hitTime + penalties);
+    }
+  }
+
+  level->penalties += penalties;
+  return level->hitTime + penalties;
+}
+
+// Perform a memory access through the icache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t
+icache_access(cache_sim *sim, uint32_t addr)
+{
+  return l1cache_access(sim, sim->ifetch, addr,
+                        getIndex(sim, sim->ifetch, addr));
 }
 
 // Perform a memory access through the dcache interface for the address 'addr'
 // Return the access time for the memory operation
 //
 uint32_t
-dcache_access(uint32_t addr)
+dcache_access(cache_sim *sim, uint32_t addr)
 {
-  if (dcacheSets == 0)
-  {
-    return l2cache_access(addr);
+  return l1cache_access(sim, &sim->dcache, addr,
+                        getIndex(sim, &sim->dcache, addr));
+}
+
+// Perform a memory access to the l2cache for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t
+l2cache_access(cache_sim *sim, uint32_t addr)
+{
+  cache_level *l2 = &sim->l2cache;
+  l2->refs++;
+  if (sim->mrc) {
+    sd_access(sim->mrc, addr);
   }
-  dcacheRefs++;
+  uint32_t set = getIndex(sim, l2, addr);
+  uint32_t tag = getTag(l2, addr);
   uint32_t target = 0;
-  uint32_t index = dgetIndex(addr);
-  if ((target = dcacheGet(addr)) < dcache[index].size()) {
-    dcacheUpdate(addr, target);
-    return dcacheHitTime;
+  profileCount(l2, set, PROFILE_REFS);
+  if ((target = cacheGet(l2, &set, tag)) < l2->assoc) {
+    repl_touch(l2, set, target);
+    if (l2->prefetch) {
+      uint32_t wait = prefetchAccess(sim, l2, addr, set, target, l2->hitTime);
+      l2->penalties += wait;
+      return l2->hitTime + wait;
+    }
+    return l2->hitTime;
   }
 
-  // if tag is not found in D$
-  dcacheMisses++;
-  uint32_t penalities = l2cache_access(addr);
-  dcacheAddData(addr);
-  dcachePenalties += penalities;
-  return dcacheHitTime + penalities;
+  // if tag is not found in L2$
+  l2->misses++;
+  profileCount(l2, set, PROFILE_MISSES);
+  uint32_t penalties = lowerFill(sim, l2, addr, set, tag);
+  l2->penalties += penalties;
+  if (l2->prefetch) {
+    prefetchAccess(sim, l2, addr, set, l2->assoc, l2->hitTime + penalties);
+  }
+  return l2->hitTime + penalties;
 }
 
-// Perform a memory access to the l2cache for the address 'addr'
+// Perform a read of 'addr' on the level 'level' below the L2
 // Return the access time for the memory operation
 //
+static uint32_t
+outerAccess(cache_sim *sim, cache_level *level, uint32_t addr)
+{
+  level->refs++;
+  uint32_t set = getIndex(sim, level, addr);
+  uint32_t tag = getTag(level, addr);
+  profileCount(level, set, PROFILE_REFS);
+  uint32_t target = cacheGet(level, &set, tag);
+  if (target < level->assoc) {
+    repl_touch(level, set, target);
+    return level->hitTime;
+  }
+
+  level->misses++;
+  profileCount(level, set, PROFILE_MISSES);
+  uint32_t penalties = lowerFill(sim, level, addr, set, tag);
+  level->penalties += penalties;
+  return level->hitTime + penalties;
+}
+
 uint32_t
-l2cache_access(uint32_t addr)
+dcache_write(cache_sim *sim, uint32_t addr)
 {
-  l2cacheRefs++;
-  uint32_t target = 0;
-  uint32_t index = l2getIndex(addr);
-  uint32_t tag = l2getTag(addr);
-  if ((target = l2cacheGet(addr)) < l2cache[index].size()) {
-    l2cacheUpdate(addr, target);
-    return l2cacheHitTime;
+  if (sim->dcache.sets == 0) {
+    return l2cache_write(sim, addr);
   }
+  return cacheWrite(sim, &sim->dcache, addr);
+}
 
-  // if tag is not found in L2$
-  l2cacheMisses++;
-  l2cacheAddData(addr);
-  l2cachePenalties += memspeed;
-  return l2cacheHitTime + memspeed;
+uint32_t
+l2cache_write(cache_sim *sim, uint32_t addr)
+{
+  if (sim->mrc) {
+    sd_access(sim->mrc, addr);
+  }
+  return cacheWrite(sim, &sim->l2cache, addr);
+}
+
+uint32_t
+cache_level_access(cache_sim *sim, cache_level *level, uint32_t addr,
+                   int write)
+{
+  if (level == &sim->l2cache) {
+    return write ? l2cache_write(sim, addr) : l2cache_access(sim, addr);
+  }
+  return write ? cacheWrite(sim, level, addr) : outerAccess(sim, level, addr);
+}
+
+//------------------------------------//
+//          Batch Functions           //
+//------------------------------------//
+
+// Run a span of accesses that does not cross an interval boundary
+// Return the sum of their access times
+//
+// The span is run in blocks of BATCH_BLOCK accesses. A first pass decodes
+// the L1 set of every access of the block with the index masks hoisted out
+// of the loop, then the second pass runs the accesses and prefetches the
+// tags of the set BATCH_AHEAD accesses ahead.
+//
+static uint64_t
+batchSpan(cache_sim *sim, const mem_access *batch, size_t n)
+{
+  uint64_t penalties = 0;
+  if (sim->sampler) {
+    return sample_run(sim, batch, n);
+  }
+  if (sim->profile) {
+    profile_batch(sim->profile, batch, n);
+  }
+  if (sim->timing) {
+    return timing_run(sim, batch, n);
+  }
+  if (sim->kernel) {
+    penalties = sim->kernel(sim, batch, n);
+    sim->totalRefs += n;
+    sim->totalPenalties += penalties;
+    return penalties;
+  }
+
+  cache_level *ilevel = sim->ifetch;
+  cache_level *dlevel = &sim->dcache;
+  uint32_t offset = sim->blockOffsetBits;
+  uint32_t imask = (1 << ilevel->indexBits) - 1;
+  uint32_t dmask = (1 << dlevel->indexBits) - 1;
+  uint32_t ifold = ilevel->fold;
+  uint32_t dfold = dlevel->fold;
+  uint32_t sets[BATCH_BLOCK];
+
+  for (size_t base = 0; base < n; base += BATCH_BLOCK) {
+    const mem_access *block = batch + base;
+    size_t count = n - base < BATCH_BLOCK ? n - base : BATCH_BLOCK;
+    for (size_t i = 0; i < count; i++) {
+      // Both sets with loop-invariant shifts, so the loop vectorizes
+      uint32_t line = block[i].addr >> offset;
+      uint32_t iset = (line ^ (line >> ifold)) & imask;
+      uint32_t dset = (line ^ (line >> dfold)) & dmask;
+      sets[i] = block[i].type == 'I' ? iset : dset;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      if (i + BATCH_AHEAD < count) {
+        cache_level *next = block[i + BATCH_AHEAD].type == 'I' ? ilevel
+                                                                : dlevel;
+        __builtin_prefetch(next->tags +
+                           (uint64_t)sets[i + BATCH_AHEAD] * next->assoc);
+      }
+
+      // Direct the memory access to the appropriate cache
+      if (block[i].type == 'I') {
+        penalties += l1cache_access(sim, ilevel, block[i].addr, sets[i]);
+      } else if (block[i].type == 'W') {
+        penalties += dcache_write(sim, block[i].addr);
+      } else {
+        penalties += l1cache_access(sim, dlevel, block[i].addr, sets[i]);
+      }
+    }
+  }
+  sim->totalRefs += n;
+  sim->totalPenalties += penalties;
+  return penalties;
+}
+
+uint64_t
+cache_access_batch(cache_sim *sim, const mem_access *batch, size_t n)
+{
+  interval_log *log = &sim->intervals;
+  if (!log->length) {
+    return batchSpan(sim, batch, n);
+  }
+
+  // Split the batch at interval boundaries, one countdown per span
+  uint64_t penalties = 0;
+  while (n > 0) {
+    size_t span = n < log->left ? n : log->left;
+    penalties += batchSpan(sim, batch, span);
+    batch += span;
+    n -= span;
+    log->left -= span;
+    if (log->left == 0) {
+      interval_sample(sim);
+      log->left = log->length;
+    }
+  }
+  return penalties;
 }
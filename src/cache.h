@@ -11,6 +11,10 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "stackdist.h"
+#include "trace.h"
+#include "interval.h"
+#include "prefetch.h"
 
 //
 // Student Information
@@ -27,63 +31,284 @@ extern const char *email;
 
 #define INVALID NULL
 
+// Cache levels below the L2, the L3 and beyond
+//
+#define MAX_OUTER_LEVELS 4
+
+// Accesses decoded per block of cache_access_batch(), and how far ahead
+// of the access being run the tags of its set are prefetched
+//
+#define BATCH_BLOCK 64
+#define BATCH_AHEAD 8
+
+// Flags kept in the block offset bits of a tag entry
+//
+#define TAG_VALID 0x1
+#define TAG_DIRTY 0x2       // Written since the fill, write-back only
+#define TAG_PREFETCH 0x4    // Filled by a prefetch, not referenced yet
+#define TAG_SHARED 0x8      // MESI S state, multicore runs only
+#define TAG_FLAGS (TAG_VALID | TAG_DIRTY | TAG_PREFETCH | TAG_SHARED)
+
 //------------------------------------//
 //        Cache Configuration         //
 //------------------------------------//
 
-extern uint32_t icacheSets;     // Number of sets in the I$
-extern uint32_t icacheAssoc;    // Associativity of the I$
-extern uint32_t icacheHitTime;  // Hit Time of the I$
+// Replacement policies, see replace.h
+//
+enum {
+  POLICY_LRU, POLICY_PLRU, POLICY_SRRIP, POLICY_BRRIP, POLICY_RANDOM,
+  POLICY_FIFO, POLICY_COUNT,
+  POLICY_STAMP = POLICY_COUNT   // LRU of a skewed level, not configurable
+};
 
-extern uint32_t dcacheSets;     // Number of sets in the D$
-extern uint32_t dcacheAssoc;    // Associativity of the D$
-extern uint32_t dcacheHitTime;  // Hit Time of the D$
+// Set index functions, see the Tag Store Structure below
+//
+enum {
+  HASH_MODULO,      // The address bits above the block offset
+  HASH_XOR,         // Those bits XORed with the next index-wide field
+  HASH_SKEWED,      // A different hash for every way
+  HASH_COUNT
+};
+
+// Inclusion policies of the L2 towards the I$ and D$
+//
+enum {
+  L2_NINE,          // Neither inclusive nor exclusive
+  L2_INCLUSIVE,     // L2 evictions invalidate the L1 copies
+  L2_EXCLUSIVE      // L1 misses fill from memory, L1 victims fill the L2
+};
 
-extern uint32_t l2cacheSets;    // Number of sets in the L2$
-extern uint32_t l2cacheAssoc;   // Associativity of the L2$
-extern uint32_t l2cacheHitTime; // Hit Time of the L2$
-extern uint32_t inclusive;      // Indicates if the L2 is inclusive
+typedef struct {
+  uint32_t sets;        // Number of sets
+  uint32_t assoc;       // Associativity
+  uint32_t hitTime;     // Hit Time
+  uint32_t policy;      // Replacement policy
+  uint32_t prefetch;    // Prefetcher, D$ and L2$ only
+  uint32_t prefetchDegree;
+  uint32_t prefetchDistance;
+  uint32_t victimEntries;   // Victim cache entries, I$ and D$ only
+  uint32_t victimHitTime;
+  uint32_t shared;      // Shared by all cores, see multicore.h
+  uint32_t hash;        // Set index function
+  uint32_t mshrs;       // Misses in flight, 0 blocks, see timing.h
+} level_config;
 
-extern uint32_t blocksize;      // Block/Line size
-extern uint32_t memspeed;       // Latency of Main Memory
+typedef struct {
+  level_config icache;  // I$ parameters
+  level_config dcache;  // D$ parameters
+  level_config l2cache; // L2$ parameters
+  level_config outer[MAX_OUTER_LEVELS];  // L3$ and below
+  uint32_t outerLevels; // Levels configured in outer
+  uint32_t unified;     // One L1, the D$, for instructions and data
+  uint32_t l2policy;    // Inclusion policy of the L2
+  uint32_t inclusionStats;  // Report back-invalidations
+  uint32_t writeThrough;    // Write hits through to the next level
+  uint32_t noWriteAllocate; // Write misses bypass the level
+
+  uint32_t blocksize;   // Block/Line size
+  uint32_t memspeed;    // Latency of Main Memory
+
+  uint32_t mrcWays;     // L2 associativities to profile, 0 for none
+  uint32_t generic;     // Never use a compile-time specialized kernel
+  uint32_t interval;    // Accesses per statistics interval, 0 for none
+  uint32_t coherent;    // Private levels of a core, see multicore.h
+  double   sampleSets;  // Fraction of the sets simulated, 0 for all
+  uint32_t sampleExact; // Also simulate all sets to check the estimates
+  uint32_t profile;     // Count per set and reuse distances, see profile.h
+  uint32_t timing;      // Estimate the cycles with MSHRs, see timing.h
+  uint32_t memInterval; // Cycles between lines read from memory, 0 for
+                        // no bandwidth limit
+} cache_config;
 
 //------------------------------------//
-//          Cache Statistics          //
+//          Cache Structures          //
 //------------------------------------//
 
-extern uint64_t icacheRefs;       // I$ references
-extern uint64_t icacheMisses;     // I$ misses
-extern uint64_t icachePenalties;  // I$ penalties
+//
+// Tag Store Structure:
+// set 0: way 0 | way 1 | ... | way assoc-1
+// set 1: way 0 | way 1 | ... | way assoc-1
+// ...
+// One flat sets x assoc array of tags, allocated once in init_cache() and
+// aligned to a cache line, so a set is compared against a probe with one
+// or a few vector compares (tagsimd.h). A tag keeps the address bits above the index
+// with the low bits zeroed, so they are free for the TAG_VALID and TAG_DIRTY
+// flags. A lookup masks the entries with tagMask | TAG_VALID, so a line is
+// found in one probe whatever its other flags.
+// TAG_PREFETCH needs blocks of at least 8 bytes, TAG_SHARED 16 bytes.
+//
+// Index Hashing:
+// HASH_XOR levels take the set from the line address XORed with itself
+// shifted by one index width. HASH_SKEWED levels index way 0 by the modulo
+// and every other way w by the low bits XORed with the top index bits of
+// the high bits times skew[w], so lines that conflict in one way rarely
+// conflict in the others. A probe that misses the way 0 set looks in one
+// set per way, and fills replace by LRU among those candidates, kept as
+// per-line timestamps in repl (POLICY_STAMP). The set of a line of a skewed
+// level depends on its way, so functions taking a set and a way take the
+// set of that way. Hashed levels keep the index bits in their tags, so a
+// tag is the whole line address whatever its set, and need blocks of at
+// least 16 bytes to keep the flags clear of it. Hashes apply to the
+// addresses the levels see, compressed ones included (addrmap.h).
+//
+// LRU Structure:
+// ages[way] is the rank of the way in its set, 0 is MRU and assoc-1 is LRU.
+// Invalid ways always hold the oldest ranks, so the victim of a fill is
+// always the way ranked assoc-1. The other replacement policies keep one
+// 64-bit word of state per set in repl (replace.h).
+//
+// Victim Cache Structure:
+// A level of one set and victimEntries ways whose tags are whole line
+// addresses. It holds the lines evicted from its L1, exclusively: a hit
+// swaps the line with the L1 victim. refs counts probes on L1 misses.
+//
+typedef struct cache_level {
+  uint32_t sets;        // Number of sets
+  uint32_t assoc;       // Associativity
+  uint32_t hitTime;     // Hit Time
+  uint32_t indexBits;
+  uint32_t tagShift;    // Block offset bits + index bits
+  uint32_t tagMask;     // Address bits kept in a tag
+  uint32_t fold;        // Shift of the HASH_XOR field, 31 for none
+  uint32_t policy;      // Replacement policy
+  uint32_t rng;         // Xorshift state of the random policies
+  uint32_t coherent;    // Lines may carry TAG_SHARED
+
+  uint32_t *tags;
+  uint16_t *ages;       // LRU ranks
+  uint64_t *repl;       // Per-set state of the other policies, per-line
+                        // timestamps for POLICY_STAMP
+  uint32_t *skew;       // Per-way index multipliers, HASH_SKEWED only
+  uint64_t clock;       // Last POLICY_STAMP timestamp
+  prefetcher *prefetch; // Prefetcher trained by the level, or NULL
+  struct cache_level *victim; // Victim cache behind the level, or NULL
+  uint64_t *setCounts;  // Per set counters when profiling, or NULL
+
+  uint64_t refs;        // References
+  uint64_t misses;      // Misses
+  uint64_t penalties;   // Penalties
+  uint64_t writes;      // Write references
+  uint64_t writebacks;  // Writes sent to the next level
+  uint64_t invalidations;   // Lines dropped for an inclusive L2
+} cache_level;
+
+struct cache_sim;
+struct mc_core;
+struct set_sampler;
+struct cache_profile;
+struct cache_timing;
+
+// Simulates 'n' accesses and returns the sum of their access times
+//
+typedef uint64_t (*cache_kernel)(struct cache_sim *sim,
+                                 const mem_access *batch, size_t n);
+
+// One independent memory hierarchy. The levels below the L2 are
+// non-inclusive, each misses to the next one and the last to memory
+//
+typedef struct cache_sim {
+  cache_config config;
+  uint32_t blockOffsetBits;
+
+  cache_level icache;
+  cache_level dcache;
+  cache_level l2cache;
+  cache_level outer[MAX_OUTER_LEVELS];
+  cache_level *ifetch;      // Level instructions are fetched from
 
-extern uint64_t dcacheRefs;       // D$ references
-extern uint64_t dcacheMisses;     // D$ misses
-extern uint64_t dcachePenalties;  // D$ penalties
+  stack_dist *mrc;          // Miss ratio curve of the L2 reference stream
+  cache_kernel kernel;      // Specialized kernel for this hierarchy or NULL
+  interval_log intervals;   // Counter snapshots every config.interval accesses
+  struct mc_core *core;     // Core of a multicore run owning the L1s, or NULL
+  struct set_sampler *sampler;  // Set sampling state, see sample.h, or NULL
+  struct cache_profile *profile;  // Reuse distances, see profile.h, or NULL
+  struct cache_timing *timing;    // Cycle estimate, see timing.h, or NULL
+  uint8_t *stateMap;        // Checkpoint the level arrays are mapped from
+  size_t stateLen;
 
-extern uint64_t l2cacheRefs;      // L2$ references
-extern uint64_t l2cacheMisses;    // L2$ misses
-extern uint64_t l2cachePenalties; // L2$ penalties
+  uint64_t totalRefs;       // Accesses from the trace
+  uint64_t totalPenalties;  // Access time of all accesses
+} cache_sim;
 
 //------------------------------------//
 //      Cache Function Prototypes     //
 //------------------------------------//
 
-// Initialize the predictor
+// Initialize the hierarchy 'sim' from 'config'
 //
-void init_cache();
+void init_cache(cache_sim *sim, const cache_config *config);
+
+// Release the memory held by 'sim'
+//
+void free_cache(cache_sim *sim);
+
+// Return the low address bits 'sim' takes block offsets and set indices
+// from, which compressed addresses must keep (addrmap.h)
+//
+uint32_t cache_region_bits(const cache_sim *sim);
+
+// Return the index hash called 'name', or -1 if there is none
+//
+int cache_hash_parse(const char *name);
+
+const char *cache_hash_name(uint32_t hash);
 
 // Perform a memory access through the icache interface for the address 'addr'
 // Return the access time for the memory operation
 //
-uint32_t icache_access(uint32_t addr);
+uint32_t icache_access(cache_sim *sim, uint32_t addr);
 
 // Perform a memory access through the dcache interface for the address 'addr'
 // Return the access time for the memory operation
 //
-uint32_t dcache_access(uint32_t addr);
+uint32_t dcache_access(cache_sim *sim, uint32_t addr);
 
 // Perform a memory access to the l2cache for the address 'addr'
 // Return the access time for the memory operation
 //
-uint32_t l2cache_access(uint32_t addr);
+uint32_t l2cache_access(cache_sim *sim, uint32_t addr);
+
+// Perform a store through the dcache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t dcache_write(cache_sim *sim, uint32_t addr);
+
+// Perform a store to the l2cache for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t l2cache_write(cache_sim *sim, uint32_t addr);
+
+// Read 'addr', or write it if 'write', starting at the L2 or outer 'level'
+// of 'sim'
+// Return the access time
+//
+uint32_t cache_level_access(cache_sim *sim, cache_level *level,
+                            uint32_t addr, int write);
+
+// Write the dirty 'entry' replaced in 'set' of 'level' to the next level
+// Return the time the writeback adds to the access that caused it
+//
+uint32_t cache_writeback(cache_sim *sim, cache_level *level, uint32_t set,
+                         uint32_t entry);
+
+// Set the flags 'add' and clear the flags 'clear' of the line holding
+// 'addr' in 'level', clearing TAG_VALID drops the line
+// Returns the entry before the change, or 0 if 'addr' was not cached
+//
+uint32_t cache_update_line(cache_sim *sim, cache_level *level, uint32_t addr,
+                           uint32_t add, uint32_t clear);
+
+//------------------------------------//
+//          Batch Interface           //
+//------------------------------------//
+
+// Run the 'n' accesses of 'batch' through 'sim', in order
+// Types other than 'I' and 'W' are data reads. Adds the accesses to the
+// totals of 'sim', samples its intervals and returns the sum of their
+// access times. Results are the same as one call per access, except that
+// a set-sampled 'sim' only runs and times the sampled accesses
+//
+uint64_t cache_access_batch(cache_sim *sim, const mem_access *batch,
+                            size_t n);
 
 #endif
@@ -0,0 +1,194 @@
+//========================================================//
+//  cachegen.cpp                                          //
+//  Synthetic Trace Generator                             //
+//                                                        //
+//  Streams synth.h patterns as a text trace to stdout,   //
+//  for piping into cache, or as a binary trace           //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "synth.h"
+
+using namespace std;
+
+#define GEN_BLOCK (1 << 16)
+
+//------------------------------------//
+//        Generator Settings          //
+//------------------------------------//
+
+synth_config config;
+uint64_t count = 10000000;    // Accesses to generate
+const char *binaryPath = NULL; // Binary trace to write, or NULL for text
+uint32_t encoding = TRACE_RAW;
+
+static void
+usage()
+{
+  fprintf(stderr,"Usage: cache-gen <options> [| ./cache <options>]\n");
+  fprintf(stderr,"  --pattern=<name>    sequential, stride, random, zipf or "
+      "chase\n");
+  fprintf(stderr,"  --count=<n>         Accesses to generate\n");
+  fprintf(stderr,"  --footprint=<bytes> Bytes of data the pattern spans\n");
+  fprintf(stderr,"  --base=<hex>        Lowest data address\n");
+  fprintf(stderr,"  --stride=<bytes>    Distance of the stride accesses\n");
+  fprintf(stderr,"  --line=<bytes>      Element size of zipf and chase\n");
+  fprintf(stderr,"  --zipf=<s>          Zipf exponent, larger is more "
+      "skewed\n");
+  fprintf(stderr,"  --ifrac=<f>         Fraction of instruction fetches\n");
+  fprintf(stderr,"  --wfrac=<f>         Fraction of data accesses that are "
+      "writes\n");
+  fprintf(stderr,"  --code=<bytes>      Bytes of the instruction loop\n");
+  fprintf(stderr,"  --seed=<n>          Random seed\n");
+  fprintf(stderr,"  --binary=<path>[:delta]  Write a binary trace instead "
+      "of text to stdout\n");
+  fprintf(stderr,"Sizes and counts take a K, M or G suffix (powers of "
+      "1024)\n");
+}
+
+// Read a count with an optional K, M or G suffix into 'v'
+//
+// Returns True if Successful
+//
+static int
+parseSize(const char *arg, uint64_t *v)
+{
+  char *end;
+  unsigned long long n = strtoull(arg, &end, 0);
+  if (end == arg) {
+    return 0;
+  }
+  const char *units = "KMG";
+  const char *unit = *end ? strchr(units, *end & ~0x20) : NULL;
+  if (unit) {
+    n <<= 10 * (unit - units + 1);
+    end++;
+  }
+  *v = n;
+  return *end == '\0';
+}
+
+static int
+handle_option(const char *arg)
+{
+  uint64_t v;
+  if (!strncmp(arg,"--pattern=",10)) {
+    int p = synth_pattern(arg+10);
+    config.pattern = p;
+    return p >= 0;
+  } else if (!strncmp(arg,"--count=",8)) {
+    return parseSize(arg+8, &count);
+  } else if (!strncmp(arg,"--footprint=",12)) {
+    return parseSize(arg+12, &config.footprint);
+  } else if (!strncmp(arg,"--base=",7)) {
+    return sscanf(arg+7,"%lx", &config.base) == 1;
+  } else if (!strncmp(arg,"--stride=",9) && parseSize(arg+9, &v)) {
+    config.stride = v;
+  } else if (!strncmp(arg,"--line=",7) && parseSize(arg+7, &v)) {
+    config.line = v;
+  } else if (!strncmp(arg,"--code=",7) && parseSize(arg+7, &v)) {
+    config.code = v;
+  } else if (!strncmp(arg,"--zipf=",7)) {
+    return sscanf(arg+7,"%lf", &config.zipf) == 1;
+  } else if (!strncmp(arg,"--ifrac=",8)) {
+    return sscanf(arg+8,"%lf", &config.ifrac) == 1;
+  } else if (!strncmp(arg,"--wfrac=",8)) {
+    return sscanf(arg+8,"%lf", &config.wfrac) == 1;
+  } else if (!strncmp(arg,"--seed=",7)) {
+    return sscanf(arg+7,"%lu", &config.seed) == 1;
+  } else if (!strncmp(arg,"--binary=",9)) {
+    char *path = strdup(arg+9);
+    char *enc = strrchr(path, ':');
+    if (enc && !strcmp(enc, ":delta")) {
+      *enc = '\0';
+      encoding = TRACE_DELTA;
+    }
+    binaryPath = path;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+//------------------------------------//
+//           Text Output              //
+//------------------------------------//
+
+// Format 'n' accesses as "0x<addr> <type>" lines at 'out'
+// Returns the bytes written, at most 14 per access
+//
+static size_t
+formatText(const mem_access *batch, size_t n, char *out)
+{
+  static const char digits[] = "0123456789abcdef";
+  char *p = out;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t addr = batch[i].addr;
+    int len = addr ? (35 - __builtin_clz(addr)) / 4 : 1;
+    *p++ = '0';
+    *p++ = 'x';
+    for (int d = len - 1; d >= 0; d--) {
+      p[d] = digits[addr & 0xf];
+      addr >>= 4;
+    }
+    p += len;
+    *p++ = ' ';
+    *p++ = batch[i].type;
+    *p++ = '\n';
+  }
+  return p - out;
+}
+
+int
+main(int argc, char *argv[])
+{
+  synth_defaults(&config);
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"--help")) {
+      usage();
+      exit(0);
+    } else if (!handle_option(argv[i])) {
+      fprintf(stderr,"Unrecognized option %s\n", argv[i]);
+      usage();
+      exit(1);
+    }
+  }
+
+  synth_gen *g = synth_create(&config);
+  vector<mem_access> batch(GEN_BLOCK);
+  trace_writer *w = NULL;
+  vector<char> text;
+  if (binaryPath) {
+    w = trace_writer_open(binaryPath, encoding);
+    if (!w) {
+      perror(binaryPath);
+      exit(1);
+    }
+  } else {
+    text.resize(GEN_BLOCK * 14);
+  }
+
+  int ok = 1;
+  for (uint64_t left = count; ok && left; ) {
+    size_t n = left < GEN_BLOCK ? left : GEN_BLOCK;
+    synth_fill(g, batch.data(), n);
+    if (w) {
+      ok = trace_write(w, batch.data(), n);
+    } else {
+      size_t len = formatText(batch.data(), n, text.data());
+      ok = fwrite(text.data(), 1, len, stdout) == len;
+    }
+    left -= n;
+  }
+
+  if (w) {
+    ok = trace_writer_close(w) && ok;
+  } else if (fflush(stdout)) {
+    ok = 0;
+  }
+  synth_free(g);
+  return ok ? 0 : 1;
+}
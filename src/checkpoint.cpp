@@ -0,0 +1,332 @@
+//========================================================//
+//  checkpoint.cpp                                        //
+//  Source file for the Simulator Checkpoints             //
+//                                                        //
+//  Level arrays are written 64-byte aligned and mapped   //
+//  back copy-on-write                                    //
+//========================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "tagsimd.h"
+
+#define CHECKPOINT_ALIGN 64
+#define CHECKPOINT_LEVELS (2 * 2 + 1 + MAX_OUTER_LEVELS)
+
+//------------------------------------//
+//        Checkpoint Helpers          //
+//------------------------------------//
+
+static void
+checkpoint_error(const char *path, const char *what)
+{
+  fprintf(stderr, "Checkpoint %s: %s\n", path, what);
+  exit(1);
+}
+
+static uint64_t
+align(uint64_t n)
+{
+  return (n + CHECKPOINT_ALIGN - 1) & ~(uint64_t)(CHECKPOINT_ALIGN - 1);
+}
+
+// List the levels of 'sim' that hold lines, in checkpoint order
+// Returns the number of levels
+//
+static int
+levelList(cache_sim *sim, cache_level **out)
+{
+  cache_level *all[3 + MAX_OUTER_LEVELS] =
+      { &sim->icache, &sim->dcache, &sim->l2cache };
+  for (uint32_t i = 0; i < sim->config.outerLevels; i++) {
+    all[3 + i] = &sim->outer[i];
+  }
+  int n = 0;
+  for (uint32_t i = 0; i < 3 + sim->config.outerLevels; i++) {
+    if (all[i]->sets) {
+      out[n++] = all[i];
+      if (all[i]->victim) {
+        out[n++] = all[i]->victim;
+      }
+    }
+  }
+  return n;
+}
+
+static uint64_t
+tagBytes(const cache_level *level)
+{
+  uint64_t lines = ((uint64_t)1 << level->indexBits) * level->assoc;
+  return (lines + TAG_PAD) * sizeof(uint32_t);
+}
+
+static uint64_t
+ageBytes(const cache_level *level)
+{
+  return ((uint64_t)1 << level->indexBits) * level->assoc * sizeof(uint16_t);
+}
+
+static uint64_t
+replBytes(const cache_level *level)
+{
+  uint64_t states = (uint64_t)1 << level->indexBits;
+  if (level->policy == POLICY_STAMP) {
+    states *= level->assoc;
+  }
+  return level->repl ? states * sizeof(uint64_t) : 0;
+}
+
+// Return the bytes 'sim' takes in a checkpoint
+//
+static uint64_t
+simBytes(cache_sim *sim)
+{
+  cache_level *levels[CHECKPOINT_LEVELS];
+  int n = levelList(sim, levels);
+  uint64_t size = align(sizeof(checkpoint_sim));
+  for (int i = 0; i < n; i++) {
+    size += align(sizeof(checkpoint_level)) + align(tagBytes(levels[i])) +
+            align(ageBytes(levels[i])) + align(replBytes(levels[i]));
+  }
+  return size;
+}
+
+// Return an error if 'sim' holds state a checkpoint does not keep
+//
+static const char *
+unsupported(const cache_sim *sim)
+{
+  if (sim->icache.prefetch || sim->dcache.prefetch || sim->l2cache.prefetch) {
+    return "prefetcher tables are not saved";
+  }
+  if (sim->mrc || sim->sampler || sim->core || sim->profile ||
+      sim->timing) {
+    return "--mrc, --sample-sets, --profile, --timing and multicore runs "
+           "are not saved";
+  }
+  return NULL;
+}
+
+static int
+sameLevel(const level_config *a, const level_config *b)
+{
+  return a->sets == b->sets && a->assoc == b->assoc &&
+         a->policy == b->policy && a->victimEntries == b->victimEntries &&
+         a->hash == b->hash;
+}
+
+// Return True if the saved 'a' and 'b' fill and replace lines alike
+//
+static int
+sameHierarchy(const cache_config *a, const cache_config *b)
+{
+  if (a->blocksize != b->blocksize || a->unified != b->unified ||
+      a->outerLevels != b->outerLevels || a->l2policy != b->l2policy ||
+      a->writeThrough != b->writeThrough ||
+      a->noWriteAllocate != b->noWriteAllocate ||
+      !sameLevel(&a->icache, &b->icache) ||
+      !sameLevel(&a->dcache, &b->dcache) ||
+      !sameLevel(&a->l2cache, &b->l2cache)) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < a->outerLevels; i++) {
+    if (!sameLevel(&a->outer[i], &b->outer[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void
+writePadded(FILE *out, const void *data, uint64_t size)
+{
+  static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+  fwrite(data, 1, size, out);
+  fwrite(zeros, 1, align(size) - size, out);
+}
+
+//------------------------------------//
+//       Checkpoint Functions         //
+//------------------------------------//
+
+int
+checkpoint_save(const char *path, cache_sim **sims, int numSims,
+                uint64_t offset)
+{
+  for (int s = 0; s < numSims; s++) {
+    const char *err = unsupported(sims[s]);
+    if (err) {
+      checkpoint_error(path, err);
+    }
+  }
+
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    return 0;
+  }
+
+  checkpoint_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CHECKPOINT_MAGIC, 4);
+  hdr.version = CHECKPOINT_VERSION;
+  hdr.sims = numSims;
+  hdr.offset = offset;
+  writePadded(out, &hdr, sizeof(hdr));
+
+  for (int s = 0; s < numSims; s++) {
+    cache_sim *sim = sims[s];
+    checkpoint_sim cs;
+    memset(&cs, 0, sizeof(cs));
+    cs.config = sim->config;
+    cs.totalRefs = sim->totalRefs;
+    cs.totalPenalties = sim->totalPenalties;
+    cs.size = simBytes(sim);
+    writePadded(out, &cs, sizeof(cs));
+
+    cache_level *levels[CHECKPOINT_LEVELS];
+    int n = levelList(sim, levels);
+    for (int i = 0; i < n; i++) {
+      cache_level *l = levels[i];
+      checkpoint_level cl;
+      memset(&cl, 0, sizeof(cl));
+      cl.sets = l->sets;
+      cl.assoc = l->assoc;
+      cl.rng = l->rng;
+      cl.refs = l->refs;
+      cl.misses = l->misses;
+      cl.penalties = l->penalties;
+      cl.writes = l->writes;
+      cl.writebacks = l->writebacks;
+      cl.invalidations = l->invalidations;
+      writePadded(out, &cl, sizeof(cl));
+      writePadded(out, l->tags, tagBytes(l));
+      writePadded(out, l->ages, ageBytes(l));
+      writePadded(out, l->repl, replBytes(l));
+    }
+  }
+
+  if (fclose(out)) {
+    perror(path);
+    return 0;
+  }
+  return 1;
+}
+
+uint64_t
+checkpoint_load(const char *path, cache_sim **sims, int numSims, int reset)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    perror(path);
+    exit(1);
+  }
+
+  checkpoint_header hdr;
+  uint64_t len = st.st_size;
+  if (len < align(sizeof(hdr)) ||
+      pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+      memcmp(hdr.magic, CHECKPOINT_MAGIC, 4) ||
+      hdr.version != CHECKPOINT_VERSION) {
+    checkpoint_error(path, "not a checkpoint of this version");
+  }
+  if (hdr.sims != (uint32_t)numSims) {
+    checkpoint_error(path, "saved with another number of configurations");
+  }
+
+  uint64_t pos = align(sizeof(hdr));
+  for (int s = 0; s < numSims; s++) {
+    cache_sim *sim = sims[s];
+    const char *err = unsupported(sim);
+    if (err) {
+      checkpoint_error(path, err);
+    }
+
+    // Each hierarchy maps the file on its own, so it can unmap it alone
+    uint8_t *map = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      perror("mmap");
+      exit(1);
+    }
+    if (pos + align(sizeof(checkpoint_sim)) > len) {
+      checkpoint_error(path, "truncated");
+    }
+    const checkpoint_sim *cs = (const checkpoint_sim *)(map + pos);
+    if (!sameHierarchy(&cs->config, &sim->config) ||
+        cs->size != simBytes(sim) || pos + cs->size > len) {
+      checkpoint_error(path, "saved with another hierarchy");
+    }
+    sim->totalRefs = reset ? 0 : cs->totalRefs;
+    sim->totalPenalties = reset ? 0 : cs->totalPenalties;
+    uint64_t at = pos + align(sizeof(checkpoint_sim));
+    pos += cs->size;
+
+    cache_level *levels[CHECKPOINT_LEVELS];
+    int n = levelList(sim, levels);
+    for (int i = 0; i < n; i++) {
+      cache_level *l = levels[i];
+      const checkpoint_level *cl = (const checkpoint_level *)(map + at);
+      if (cl->sets != l->sets || cl->assoc != l->assoc) {
+        checkpoint_error(path, "saved with another hierarchy");
+      }
+      l->rng = cl->rng;
+      if (!reset) {
+        l->refs = cl->refs;
+        l->misses = cl->misses;
+        l->penalties = cl->penalties;
+        l->writes = cl->writes;
+        l->writebacks = cl->writebacks;
+        l->invalidations = cl->invalidations;
+      }
+      at += align(sizeof(checkpoint_level));
+
+      // Use the saved arrays in place of the ones init_cache() made
+      uint64_t tags = align(tagBytes(l));
+      uint64_t ages = align(ageBytes(l));
+      uint64_t repl = align(replBytes(l));
+      free(l->tags);
+      free(l->ages);
+      free(l->repl);
+      l->tags = (uint32_t *)(map + at);
+      l->ages = (uint16_t *)(map + at + tags);
+      l->repl = repl ? (uint64_t *)(map + at + tags + ages) : NULL;
+      at += tags + ages + repl;
+
+      // The clock carries on from the newest timestamp
+      if (l->policy == POLICY_STAMP) {
+        uint64_t lines = ((uint64_t)1 << l->indexBits) * l->assoc;
+        l->clock = 0;
+        for (uint64_t j = 0; j < lines; j++) {
+          l->clock = l->repl[j] > l->clock ? l->repl[j] : l->clock;
+        }
+      }
+    }
+    sim->stateMap = map;
+    sim->stateLen = len;
+  }
+
+  close(fd);
+  return hdr.offset;
+}
+
+void
+checkpoint_release(cache_sim *sim)
+{
+  cache_level *levels[CHECKPOINT_LEVELS];
+  int n = levelList(sim, levels);
+  for (int i = 0; i < n; i++) {
+    levels[i]->tags = NULL;
+    levels[i]->ages = NULL;
+    levels[i]->repl = NULL;
+  }
+  munmap(sim->stateMap, sim->stateLen);
+  sim->stateMap = NULL;
+  sim->stateLen = 0;
+}
@@ -0,0 +1,84 @@
+//========================================================//
+//  checkpoint.h                                          //
+//  Header file for the Simulator Checkpoints             //
+//                                                        //
+//  Saves the tag arrays, replacement state and counters  //
+//  of warmed hierarchies and maps them back in           //
+//========================================================//
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "cache.h"
+
+//------------------------------------//
+//        Checkpoint Format           //
+//------------------------------------//
+//
+// header:  checkpoint_header
+// per hierarchy, in the order they were simulated:
+//   checkpoint_sim
+//   per level present (I$, its victim cache, D$, its victim cache, L2$,
+//   L3$ and below): checkpoint_level, then the tags, the LRU ranks and
+//   the per-set replacement state of the level (per line for skewed
+//   levels)
+//
+// Every record and array starts on a 64-byte boundary of the file, so the
+// arrays of a loaded checkpoint are used in place from a private mapping
+// and only the pages the run writes are copied.
+//
+#define CHECKPOINT_MAGIC   "CSTA"
+#define CHECKPOINT_VERSION 2
+
+typedef struct {
+  char     magic[4];
+  uint32_t version;
+  uint32_t sims;        // Hierarchies in the checkpoint
+  uint32_t reserved;
+  uint64_t offset;      // Trace accesses simulated before the checkpoint
+} checkpoint_header;
+
+typedef struct {
+  cache_config config;
+  uint64_t totalRefs;
+  uint64_t totalPenalties;
+  uint64_t size;        // Bytes of the hierarchy, this record included
+} checkpoint_sim;
+
+typedef struct {
+  uint32_t sets;
+  uint32_t assoc;
+  uint32_t rng;
+  uint32_t reserved;
+  uint64_t refs;
+  uint64_t misses;
+  uint64_t penalties;
+  uint64_t writes;
+  uint64_t writebacks;
+  uint64_t invalidations;
+} checkpoint_level;
+
+//------------------------------------//
+//   Checkpoint Function Prototypes   //
+//------------------------------------//
+
+// Write the state of 'sims' at 'offset' trace accesses to 'path'
+//
+// Returns True if Successful
+//
+int checkpoint_save(const char *path, cache_sim **sims, int numSims,
+                    uint64_t offset);
+
+// Map the state of 'sims' from the checkpoint 'path', zeroing the counters
+// if 'reset' is set. The hierarchies must be configured as when it was
+// saved, exits with a message otherwise
+// Returns the trace offset of the checkpoint
+//
+uint64_t checkpoint_load(const char *path, cache_sim **sims, int numSims,
+                         int reset);
+
+// Unmap the arrays 'sim' took from a checkpoint, free_cache() calls it
+//
+void checkpoint_release(cache_sim *sim);
+
+#endif
@@ -0,0 +1,343 @@
+//========================================================//
+//  decoder.c                                             //
+//  Source file for the Trace Decoder                     //
+//                                                        //
+//  One producer thread fills two buffers in turn while   //
+//  the reader parses the other one                       //
+//========================================================//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "decoder.h"
+
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define INPUT_BLOCK (1 << 18)   // Compressed bytes read at a time
+
+#define FORMAT_PLAIN 0
+#define FORMAT_BZIP2 1
+#define FORMAT_GZIP  2
+#define FORMAT_ZSTD  3
+
+//------------------------------------//
+//        Decoder Structures          //
+//------------------------------------//
+
+struct trace_decoder {
+  FILE    *in;
+  int      format;
+  uint8_t *input;         // Raw bytes read from 'in'
+  size_t   inputLen;
+  size_t   inputPos;
+  int      inputEnd;      // 'in' has no more bytes
+  int      streamEnd;     // The last compressed stream was complete
+
+#ifdef HAVE_BZIP2
+  bz_stream bz;
+#endif
+#ifdef HAVE_ZLIB
+  z_stream  z;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_DStream *zs;
+#endif
+
+  // Double buffer, guarded by 'lock'
+  char    *data[2];
+  size_t   len[2];
+  int      full[2];       // Buffer holds bytes the reader has not released
+  int      next;          // Buffer the reader takes next
+  int      stop;
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+  pthread_t thread;
+};
+
+//------------------------------------//
+//         Decoding Functions         //
+//------------------------------------//
+
+static void
+decode_error(const char *what)
+{
+  fprintf(stderr, "Trace decoding error: %s\n", what);
+  exit(1);
+}
+
+// Make sure raw input is buffered
+//
+// Returns True if there is input left
+//
+static int
+input_available(trace_decoder *dec)
+{
+  if (dec->inputPos == dec->inputLen && !dec->inputEnd) {
+    dec->inputLen = fread(dec->input, 1, INPUT_BLOCK, dec->in);
+    dec->inputPos = 0;
+    dec->inputEnd = dec->inputLen == 0;
+  }
+  return dec->inputPos < dec->inputLen;
+}
+
+static int
+detect_format(trace_decoder *dec)
+{
+  input_available(dec);
+  const uint8_t *m = dec->input;
+  size_t n = dec->inputLen;
+  if (n >= 3 && m[0] == 'B' && m[1] == 'Z' && m[2] == 'h') {
+    return FORMAT_BZIP2;
+  } else if (n >= 2 && m[0] == 0x1f && m[1] == 0x8b) {
+    return FORMAT_GZIP;
+  } else if (n >= 4 && m[0] == 0x28 && m[1] == 0xb5 &&
+             m[2] == 0x2f && m[3] == 0xfd) {
+    return FORMAT_ZSTD;
+  }
+  return FORMAT_PLAIN;
+}
+
+static void
+codec_init(trace_decoder *dec)
+{
+  switch (dec->format) {
+#ifdef HAVE_BZIP2
+    case FORMAT_BZIP2:
+      memset(&dec->bz, 0, sizeof(dec->bz));
+      if (BZ2_bzDecompressInit(&dec->bz, 0, 0) != BZ_OK)
+        decode_error("bzip2 init");
+      break;
+#endif
+#ifdef HAVE_ZLIB
+    case FORMAT_GZIP:
+      memset(&dec->z, 0, sizeof(dec->z));
+      if (inflateInit2(&dec->z, 15 + 32) != Z_OK)
+        decode_error("gzip init");
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case FORMAT_ZSTD:
+      dec->zs = ZSTD_createDStream();
+      if (!dec->zs || ZSTD_isError(ZSTD_initDStream(dec->zs)))
+        decode_error("zstd init");
+      break;
+#endif
+    case FORMAT_PLAIN:
+      break;
+    default:
+      decode_error("this build has no support for the trace compression");
+  }
+  dec->streamEnd = 1;
+}
+
+static void
+codec_end(trace_decoder *dec)
+{
+  switch (dec->format) {
+#ifdef HAVE_BZIP2
+    case FORMAT_BZIP2: BZ2_bzDecompressEnd(&dec->bz); break;
+#endif
+#ifdef HAVE_ZLIB
+    case FORMAT_GZIP:  inflateEnd(&dec->z); break;
+#endif
+#ifdef HAVE_ZSTD
+    case FORMAT_ZSTD:  ZSTD_freeDStream(dec->zs); break;
+#endif
+  }
+}
+
+// Fill 'out' with up to 'cap' decoded bytes
+// Returns the number of bytes, less than 'cap' only at the end of input
+//
+static size_t
+decode_block(trace_decoder *dec, char *out, size_t cap)
+{
+  size_t produced = 0;
+  while (produced < cap && input_available(dec)) {
+    uint8_t *in = dec->input + dec->inputPos;
+    size_t avail = dec->inputLen - dec->inputPos;
+    size_t used = 0;
+    size_t before = produced;
+
+    switch (dec->format) {
+      case FORMAT_PLAIN: {
+        used = avail < cap - produced ? avail : cap - produced;
+        memcpy(out + produced, in, used);
+        produced += used;
+        break;
+      }
+#ifdef HAVE_BZIP2
+      case FORMAT_BZIP2: {
+        // Concatenated streams (pbzip2) restart the decompressor
+        if (dec->streamEnd && dec->bz.total_in_lo32) {
+          BZ2_bzDecompressEnd(&dec->bz);
+          codec_init(dec);
+        }
+        dec->bz.next_in = (char *)in;
+        dec->bz.avail_in = avail;
+        dec->bz.next_out = out + produced;
+        dec->bz.avail_out = cap - produced;
+        int ret = BZ2_bzDecompress(&dec->bz);
+        if (ret != BZ_OK && ret != BZ_STREAM_END)
+          decode_error("corrupt bzip2 stream");
+        dec->streamEnd = ret == BZ_STREAM_END;
+        used = avail - dec->bz.avail_in;
+        produced = cap - dec->bz.avail_out;
+        break;
+      }
+#endif
+#ifdef HAVE_ZLIB
+      case FORMAT_GZIP: {
+        // Concatenated gzip members restart the inflater
+        if (dec->streamEnd && dec->z.total_in) {
+          inflateReset(&dec->z);
+        }
+        dec->z.next_in = in;
+        dec->z.avail_in = avail;
+        dec->z.next_out = (Bytef *)out + produced;
+        dec->z.avail_out = cap - produced;
+        int ret = inflate(&dec->z, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+          decode_error("corrupt gzip stream");
+        dec->streamEnd = ret == Z_STREAM_END;
+        used = avail - dec->z.avail_in;
+        produced = cap - dec->z.avail_out;
+        break;
+      }
+#endif
+#ifdef HAVE_ZSTD
+      case FORMAT_ZSTD: {
+        ZSTD_inBuffer zin = { in, avail, 0 };
+        ZSTD_outBuffer zout = { out, cap, produced };
+        size_t ret = ZSTD_decompressStream(dec->zs, &zout, &zin);
+        if (ZSTD_isError(ret))
+          decode_error("corrupt zstd stream");
+        dec->streamEnd = ret == 0;
+        used = zin.pos;
+        produced = zout.pos;
+        break;
+      }
+#endif
+    }
+    if (used == 0 && produced == before) {
+      decode_error("corrupt compressed stream");
+    }
+    dec->inputPos += used;
+  }
+
+  if (produced < cap && !dec->streamEnd) {
+    decode_error("truncated trace");
+  }
+  return produced;
+}
+
+//------------------------------------//
+//        Decoder Thread              //
+//------------------------------------//
+
+static void *
+decode_main(void *arg)
+{
+  trace_decoder *dec = (trace_decoder *)arg;
+  for (int k = 0; ; k ^= 1) {
+    pthread_mutex_lock(&dec->lock);
+    while (dec->full[k] && !dec->stop) {
+      pthread_cond_wait(&dec->cond, &dec->lock);
+    }
+    int stop = dec->stop;
+    pthread_mutex_unlock(&dec->lock);
+    if (stop) {
+      break;
+    }
+
+    size_t n = decode_block(dec, dec->data[k], DECODER_BLOCK);
+
+    pthread_mutex_lock(&dec->lock);
+    dec->len[k] = n;
+    dec->full[k] = 1;
+    pthread_cond_broadcast(&dec->cond);
+    pthread_mutex_unlock(&dec->lock);
+    if (n == 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+//------------------------------------//
+//        Decoder Functions           //
+//------------------------------------//
+
+trace_decoder *
+decoder_start(FILE *in)
+{
+  trace_decoder *dec = (trace_decoder *)calloc(1, sizeof(trace_decoder));
+  dec->in = in;
+  dec->input = (uint8_t *)malloc(INPUT_BLOCK);
+  dec->data[0] = (char *)malloc(DECODER_BLOCK);
+  dec->data[1] = (char *)malloc(DECODER_BLOCK);
+  if (!dec->input || !dec->data[0] || !dec->data[1]) {
+    decode_error("out of memory");
+  }
+
+  dec->format = detect_format(dec);
+  codec_init(dec);
+
+  pthread_mutex_init(&dec->lock, NULL);
+  pthread_cond_init(&dec->cond, NULL);
+  if (pthread_create(&dec->thread, NULL, decode_main, dec)) {
+    decode_error("unable to start the decoder thread");
+  }
+  return dec;
+}
+
+size_t
+decoder_next(trace_decoder *dec, const char **data)
+{
+  int k = dec->next;
+  pthread_mutex_lock(&dec->lock);
+  while (!dec->full[k]) {
+    pthread_cond_wait(&dec->cond, &dec->lock);
+  }
+  pthread_mutex_unlock(&dec->lock);
+
+  *data = dec->data[k];
+  return dec->len[k];
+}
+
+void
+decoder_release(trace_decoder *dec)
+{
+  pthread_mutex_lock(&dec->lock);
+  dec->full[dec->next] = 0;
+  pthread_cond_broadcast(&dec->cond);
+  pthread_mutex_unlock(&dec->lock);
+  dec->next ^= 1;
+}
+
+void
+decoder_stop(trace_decoder *dec)
+{
+  pthread_mutex_lock(&dec->lock);
+  dec->stop = 1;
+  pthread_cond_broadcast(&dec->cond);
+  pthread_mutex_unlock(&dec->lock);
+  pthread_join(dec->thread, NULL);
+
+  codec_end(dec);
+  pthread_mutex_destroy(&dec->lock);
+  pthread_cond_destroy(&dec->cond);
+  free(dec->input);
+  free(dec->data[0]);
+  free(dec->data[1]);
+  free(dec);
+}
@@ -0,0 +1,41 @@
+//========================================================//
+//  decoder.h                                             //
+//  Header file for the Trace Decoder                     //
+//                                                        //
+//  Reads and decompresses (bzip2, gzip, zstd) a trace    //
+//  stream on a background thread into two reusable      //
+//  buffers, so decoding overlaps with simulation         //
+//========================================================//
+
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define DECODER_BLOCK (1 << 20)   // Decoded bytes per buffer
+
+struct trace_decoder;
+
+//------------------------------------//
+//     Decoder Function Prototypes    //
+//------------------------------------//
+
+// Start decoding 'in', the format is detected from its first bytes
+//
+struct trace_decoder *decoder_start(FILE *in);
+
+// Wait for the next block of decoded bytes and point 'data' at it
+// Returns the size of the block, 0 at the end of the stream
+//
+size_t decoder_next(struct trace_decoder *dec, const char **data);
+
+// Hand the block from decoder_next back to the decoding thread
+//
+void decoder_release(struct trace_decoder *dec);
+
+// Stop the decoding thread and free 'dec', 'in' is left open
+//
+void decoder_stop(struct trace_decoder *dec);
+
+#endif
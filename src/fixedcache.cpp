@@ -0,0 +1,277 @@
+//========================================================//
+//  fixedcache.cpp                                        //
+//  Source file for the Preset Cache Hierarchies          //
+//                                                        //
+//  Same tag arrays and LRU ranks as cache.cpp, but with  //
+//  the geometry known at compile time                    //
+//========================================================//
+
+#include "fixedcache.h"
+#include "tagsimd.h"
+
+//------------------------------------//
+//        Compile-time Helpers        //
+//------------------------------------//
+
+constexpr uint32_t
+clog2(uint32_t n)
+{
+  return n <= 1 ? 0 : 1 + clog2(n / 2);
+}
+
+// Call f(0) .. f(N-1), fully unrolled
+//
+template <uint32_t N>
+struct Unroll {
+  template <class F>
+  static inline void run(F f) { Unroll<N - 1>::run(f); f(N - 1); }
+};
+
+template <>
+struct Unroll<0> {
+  template <class F>
+  static inline void run(F) {}
+};
+
+//------------------------------------//
+//        Fixed Cache Level           //
+//------------------------------------//
+
+//
+// One cache level with constexpr shifts and masks. Sets == 0 means the
+// level is absent and accesses go straight to the next one.
+//
+template <uint32_t Sets, uint32_t Assoc, uint32_t BlockSize>
+struct Cache {
+  static const uint32_t sets = Sets;
+  static const uint32_t assoc = Assoc;
+  static const uint32_t offsetBits = clog2(BlockSize);
+  static const uint32_t tagShift = offsetBits + clog2(Sets);
+  static const uint32_t indexMask = (1u << clog2(Sets)) - 1;
+
+  static inline uint32_t
+  index(uint32_t addr)
+  {
+    return (addr >> offsetBits) & indexMask;
+  }
+
+  static inline uint32_t
+  tag(uint32_t addr)
+  {
+    return addr >> tagShift << tagShift;
+  }
+
+  // Return the way holding 'tag' in 'set', or Assoc if it is not present
+  //
+  static inline uint32_t
+  get(const cache_level *level, uint32_t set, uint32_t tag)
+  {
+    const uint32_t *ways = level->tags + set * Assoc;
+    return tag_find(ways, Assoc, tag | TAG_VALID, ~0u << tagShift | TAG_VALID);
+  }
+
+  // Make 'way' the MRU of its set
+  //
+  static inline void
+  update(cache_level *level, uint32_t set, uint32_t way)
+  {
+    uint16_t *ages = level->ages + set * Assoc;
+    uint16_t age = ages[way];
+    Unroll<Assoc>::run([&](uint32_t w) { ages[w] += (ages[w] < age); });
+    ages[way] = 0;
+  }
+
+  // Drop the line holding 'addr' if it is cached
+  // Returns the dropped entry, or 0 if 'addr' was not cached
+  //
+  static inline uint32_t
+  invalidate(cache_level *level, uint32_t addr)
+  {
+    uint32_t set = index(addr);
+    uint32_t way = get(level, set, tag(addr));
+    if (way == Assoc) {
+      return 0;
+    }
+    uint32_t entry = level->tags[set * Assoc + way];
+    uint16_t *ages = level->ages + set * Assoc;
+    uint16_t age = ages[way];
+    Unroll<Assoc>::run([&](uint32_t w) { ages[w] -= (ages[w] > age); });
+    ages[way] = (uint16_t)(Assoc - 1);
+    level->tags[set * Assoc + way] = 0;
+    return entry;
+  }
+
+  // Insert 'tag' into 'set' replacing the LRU way
+  // Returns the replaced entry, which has TAG_VALID set if a line was evicted
+  //
+  static inline uint32_t
+  addData(cache_level *level, uint32_t set, uint32_t tag)
+  {
+    const uint16_t *ages = level->ages + set * Assoc;
+    uint32_t way = 0;
+    Unroll<Assoc>::run([&](uint32_t w) {
+      way = ages[w] == Assoc - 1 ? w : way;
+    });
+    uint32_t victim = level->tags[set * Assoc + way];
+    level->tags[set * Assoc + way] = tag | TAG_VALID;
+    update(level, set, way);
+    return victim;
+  }
+};
+
+//------------------------------------//
+//       Fixed Cache Hierarchy        //
+//------------------------------------//
+
+template <class I, class D, class L2, bool Inclusive>
+struct Hierarchy {
+  // Drop the copy of the L2 victim 'addr' from the L1 'level'
+  // Return TAG_DIRTY if it was dirty
+  //
+  template <class L1>
+  static inline uint32_t
+  backInvalidate(cache_level *level, uint32_t addr)
+  {
+    uint32_t entry = L1::invalidate(level, addr);
+    level->invalidations += entry != 0;
+    return entry & TAG_DIRTY;
+  }
+
+  static inline uint32_t
+  l2cacheAccess(cache_sim *sim, uint32_t addr)
+  {
+    cache_level *l2 = &sim->l2cache;
+    l2->refs++;
+    uint32_t set = L2::index(addr);
+    uint32_t tag = L2::tag(addr);
+    uint32_t target = L2::get(l2, set, tag);
+    if (target < L2::assoc) {
+      L2::update(l2, set, target);
+      return l2->hitTime;
+    }
+
+    l2->misses++;
+    uint32_t victim = L2::addData(l2, set, tag);
+    if (Inclusive && (victim & TAG_VALID)) {
+      uint32_t reconstruct = (victim & ~TAG_FLAGS) |
+                             (set << L2::offsetBits);
+      if (I::sets)
+        victim |= backInvalidate<I>(&sim->icache, reconstruct);
+      if (D::sets)
+        victim |= backInvalidate<D>(&sim->dcache, reconstruct);
+    }
+    uint32_t penalties = sim->config.memspeed;
+    if (victim & TAG_DIRTY) {
+      penalties += cache_writeback(sim, l2, set, victim);
+    }
+    l2->penalties += penalties;
+    return l2->hitTime + penalties;
+  }
+
+  template <class L1>
+  static inline uint32_t
+  l1cacheAccess(cache_sim *sim, cache_level *level, uint32_t addr)
+  {
+    if (L1::sets == 0) {
+      return l2cacheAccess(sim, addr);
+    }
+    level->refs++;
+    uint32_t set = L1::index(addr);
+    uint32_t tag = L1::tag(addr);
+    uint32_t target = L1::get(level, set, tag);
+    if (target < L1::assoc) {
+      L1::update(level, set, target);
+      return level->hitTime;
+    }
+
+    level->misses++;
+    uint32_t penalties = l2cacheAccess(sim, addr);
+    uint32_t victim = L1::addData(level, set, tag);
+    if (victim & TAG_DIRTY) {
+      penalties += cache_writeback(sim, level, set, victim);
+    }
+    level->penalties += penalties;
+    return level->hitTime + penalties;
+  }
+
+  static uint64_t
+  run(cache_sim *sim, const mem_access *batch, size_t n)
+  {
+    uint64_t penalties = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (batch[i].type == 'I') {
+        penalties += l1cacheAccess<I>(sim, &sim->icache, batch[i].addr);
+      } else if (batch[i].type == 'W') {
+        // Stores are rare enough to take the generic path, which
+        // shares the tag arrays and LRU ranks with this kernel
+        penalties += dcache_write(sim, batch[i].addr);
+      } else {
+        penalties += l1cacheAccess<D>(sim, &sim->dcache, batch[i].addr);
+      }
+    }
+    return penalties;
+  }
+};
+
+//------------------------------------//
+//            Presets                 //
+//------------------------------------//
+
+// The geometry of one preset level, hit times are not matched
+//
+typedef struct {
+  uint32_t sets;
+  uint32_t assoc;
+} fixed_level;
+
+typedef struct {
+  fixed_level icache, dcache, l2cache;
+  uint32_t blocksize;
+  uint32_t inclusive;
+  cache_kernel kernel;
+} fixed_preset;
+
+#define PRESET(IS, IA, DS, DA, LS, LA, B, INCL)                         \
+  { {IS, IA}, {DS, DA}, {LS, LA}, B, INCL,                              \
+    &Hierarchy<Cache<IS, IA, B>, Cache<DS, DA, B>, Cache<LS, LA, B>,    \
+               INCL>::run }
+
+static const fixed_preset presets[] = {
+  PRESET(256, 1, 256, 1,   512, 8,  64, true),   // INTEL
+  PRESET(128, 2, 128, 4,   256, 8,  64, false),  // ARM
+  PRESET(128, 2,  64, 4,   128, 8, 128, true),   // MIPS
+  PRESET(512, 2, 256, 4, 16384, 8,  64, true),   // ALPHA
+  PRESET(  0, 0,   0, 0,     8, 1, 128, false),  // BTCMINER
+};
+
+static bool
+same_geometry(const level_config *a, const fixed_level *b)
+{
+  return a->sets == b->sets &&
+         (a->sets == 0 || (a->assoc == b->assoc && a->policy == POLICY_LRU &&
+                           a->prefetch == PREFETCH_NONE &&
+                           a->victimEntries == 0));
+}
+
+cache_kernel
+fixed_kernel(const cache_sim *sim)
+{
+  const cache_config *c = &sim->config;
+  if (c->generic || sim->mrc || c->outerLevels || c->unified ||
+      c->coherent || c->sampleSets || c->profile || c->timing ||
+      c->icache.hash || c->dcache.hash || c->l2cache.hash) {
+    return NULL;
+  }
+
+  for (size_t p = 0; p < sizeof(presets) / sizeof(presets[0]); p++) {
+    const fixed_preset *f = &presets[p];
+    if (same_geometry(&c->icache, &f->icache) &&
+        same_geometry(&c->dcache, &f->dcache) &&
+        same_geometry(&c->l2cache, &f->l2cache) &&
+        c->blocksize == f->blocksize && c->l2policy != L2_EXCLUSIVE &&
+        (c->l2policy == L2_INCLUSIVE) == f->inclusive) {
+      return f->kernel;
+    }
+  }
+  return NULL;
+}
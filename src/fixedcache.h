@@ -0,0 +1,19 @@
+//========================================================//
+//  fixedcache.h                                          //
+//  Header file for the Preset Cache Hierarchies          //
+//                                                        //
+//  Compile-time specialized simulation of the standard   //
+//  INTEL/ARM/MIPS/ALPHA/BTCMINER hierarchies             //
+//========================================================//
+
+#ifndef FIXEDCACHE_H
+#define FIXEDCACHE_H
+
+#include "cache.h"
+
+// Return the specialized kernel for the hierarchy of 'sim', or NULL if
+// its configuration is not one of the presets
+//
+cache_kernel fixed_kernel(const cache_sim *sim);
+
+#endif
@@ -0,0 +1,117 @@
+//========================================================//
+//  interval.cpp                                          //
+//  Source file for the Interval Statistics               //
+//========================================================//
+
+#include <string.h>
+#include "interval.h"
+#include "cache.h"
+
+static_assert(INTERVAL_LEVELS == 3 + MAX_OUTER_LEVELS,
+              "an interval column group per level");
+
+//------------------------------------//
+//         Interval Helpers           //
+//------------------------------------//
+
+// Return the current counters of 'sim'
+//
+static interval_snapshot
+snapshot(const cache_sim *sim)
+{
+  const cache_level *levels[INTERVAL_LEVELS] =
+      { &sim->icache, &sim->dcache, &sim->l2cache };
+  for (int i = 0; i < MAX_OUTER_LEVELS; i++) {
+    levels[3 + i] = &sim->outer[i];
+  }
+  interval_snapshot s;
+  s.accesses = sim->totalRefs;
+  s.penalties = sim->totalPenalties;
+  for (int i = 0; i < INTERVAL_LEVELS; i++) {
+    s.level[i].refs = levels[i]->refs;
+    s.level[i].misses = levels[i]->misses;
+    s.level[i].penalties = levels[i]->penalties;
+  }
+  return s;
+}
+
+// Write the row of the interval ending at the current counters of 'sim'
+//
+static void
+writeRow(cache_sim *sim)
+{
+  interval_log *log = &sim->intervals;
+  interval_snapshot s = snapshot(sim);
+  const interval_snapshot *p = &log->prev;
+
+  // One write per row, so the rows of concurrent hierarchies stay whole
+  char row[64 + INTERVAL_LEVELS * 3 * 21];
+  int len = snprintf(row, sizeof(row), "%d,%lu,%lu", log->config,
+                     log->index, s.accesses - p->accesses);
+  for (int l = 0; l < INTERVAL_LEVELS; l++) {
+    len += snprintf(row + len, sizeof(row) - len, ",%lu,%lu,%lu",
+                    s.level[l].refs - p->level[l].refs,
+                    s.level[l].misses - p->level[l].misses,
+                    s.level[l].penalties - p->level[l].penalties);
+  }
+  snprintf(row + len, sizeof(row) - len, ",%lu\n",
+           s.penalties - p->penalties);
+  fputs(row, log->out);
+
+  log->prev = s;
+  log->index++;
+}
+
+//------------------------------------//
+//        Interval Functions          //
+//------------------------------------//
+
+void
+interval_init(interval_log *log, uint64_t length)
+{
+  memset(log, 0, sizeof(*log));
+  log->length = length;
+  log->left = length;
+}
+
+void
+interval_open(cache_sim *sim, FILE *out, int config)
+{
+  interval_log *log = &sim->intervals;
+  log->out = out;
+  log->config = config;
+  log->index = 0;
+  log->prev = snapshot(sim);
+}
+
+void
+interval_sample(cache_sim *sim)
+{
+  if (sim->intervals.out) {
+    writeRow(sim);
+  }
+}
+
+void
+interval_close(cache_sim *sim)
+{
+  interval_log *log = &sim->intervals;
+  if (log->out && sim->totalRefs != log->prev.accesses) {
+    writeRow(sim);
+  }
+  log->out = NULL;
+}
+
+void
+interval_header(FILE *out)
+{
+  const char *names[INTERVAL_LEVELS] =
+      { "icache", "dcache", "l2cache", "l3cache", "l4cache", "l5cache",
+        "l6cache" };
+  fprintf(out, "config,interval,accesses");
+  for (int l = 0; l < INTERVAL_LEVELS; l++) {
+    fprintf(out, ",%s_refs,%s_misses,%s_penalties", names[l], names[l],
+        names[l]);
+  }
+  fprintf(out, ",penalties\n");
+}
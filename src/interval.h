@@ -0,0 +1,74 @@
+//========================================================//
+//  interval.h                                            //
+//  Header file for the Interval Statistics               //
+//                                                        //
+//  Snapshots the counters of a hierarchy every N         //
+//  accesses and writes the deltas as a CSV time series   //
+//========================================================//
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct cache_sim;
+
+//
+// The counters are snapshotted, never reset, so the hot path does not
+// change. cache_access_batch() splits each batch at interval boundaries with
+// one countdown per batch and calls interval_sample() at every boundary,
+// which writes the delta from the previous snapshot as one CSV row. Only
+// that snapshot is kept. The first one is taken when the series is opened,
+// so a run resumed from a checkpoint counts from where it starts.
+//
+
+#define INTERVAL_LEVELS 7     // I$, D$, L2$ and the outer levels, L3$..L6$
+
+typedef struct {
+  uint64_t refs;
+  uint64_t misses;
+  uint64_t penalties;
+} interval_counts;
+
+typedef struct {
+  uint64_t accesses;          // Trace accesses at the end of the interval
+  uint64_t penalties;         // Total access time
+  interval_counts level[INTERVAL_LEVELS];
+} interval_snapshot;
+
+typedef struct {
+  uint64_t length;            // Accesses per interval
+  uint64_t left;              // Accesses left in the current interval
+  FILE *out;                  // Where the rows go, or NULL
+  int config;                 // Label of the rows
+  uint64_t index;             // Number of the next row
+  interval_snapshot prev;     // Counters at the start of the interval
+} interval_log;
+
+//------------------------------------//
+//    Interval Function Prototypes    //
+//------------------------------------//
+
+// Start a series of 'length' access intervals, 0 disables it
+//
+void interval_init(interval_log *log, uint64_t length);
+
+// Write the intervals of 'sim' from its current counters on to 'out', as
+// CSV rows labeled 'config'. Rows from several threads may share 'out'
+//
+void interval_open(struct cache_sim *sim, FILE *out, int config);
+
+// Write the row of the interval of 'sim' that just ended
+//
+void interval_sample(struct cache_sim *sim);
+
+// Write the last partial interval of 'sim', if any, and stop the series
+//
+void interval_close(struct cache_sim *sim);
+
+// Write the CSV header line
+//
+void interval_header(FILE *out);
+
+#endif
@@ -8,11 +8,39 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
 #include "cache.h"
+#include "trace.h"
+#include "sweep.h"
+#include "replace.h"
+#include "multicore.h"
+#include "sample.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "timing.h"
 
-FILE *stream;
-char *buf = NULL;
-size_t len = 0;
+const char *tracePath = NULL;
+char **tracePaths = NULL; // Every trace on the command line
+int numTraces = 0;
+const char *convertPath = NULL;
+uint32_t convertEncoding = TRACE_RAW;
+const char *configPath = NULL;
+const char *intervalPath = NULL;
+const char *profilePath = NULL;   // Prefix of the profile CSV files
+int threads = 0;          // Sweep workers, 0 for one per core
+int multicoreRun = FALSE; // One core per trace
+int interleave = MC_ROUND_ROBIN;
+uint64_t quantum = 1000;  // Accesses or cycles between coherence steps
+char *savePath = NULL;    // Checkpoint written at the end of the run
+uint64_t saveAfter = 0;   // Trace accesses to run before it, 0 for all
+char *loadPath = NULL;    // Checkpoint the run starts from
+int loadReset = FALSE;    // Zero the counters of the loaded checkpoint
+
+cache_config config;      // Configuration from the command line
+cache_sim **sims = NULL;  // One hierarchy per configuration
+char **simNames = NULL;   // Options each configuration was built from
+int numSims = 0;
 
 // Print out the Usage information to stderr
 //
@@ -21,36 +49,420 @@ usage()
 {
   fprintf(stderr,"Usage: cache <options> [<trace>]\n");
   fprintf(stderr,"       bunzip -kc trace.bz2 | cache <options>\n");
+  fprintf(stderr,"       cache --convert=trace.ctr trace.bz2\n");
+  fprintf(stderr," <trace> is text, optionally bzip2/gzip/zstd compressed,\n");
+  fprintf(stderr," or a binary trace written by --convert. Text lines are\n");
+  fprintf(stderr," 0x<addr> <I|D|W> [asid] with addresses of up to 64 bits,\n");
+  fprintf(stderr," binary traces hold 32-bit addresses\n");
   fprintf(stderr," Options:\n");
   fprintf(stderr," --help                     Print this message\n");
   fprintf(stderr," --icache=sets:assoc:hit    I-cache Parameters\n");
   fprintf(stderr," --dcache=sets:assoc:hit    D-cache Parameters\n");
   fprintf(stderr," --l2cache=sets:assoc:hit   L2-cache Parameters\n");
+  fprintf(stderr," --level=name:sets:assoc:hit[:shared]\n");
+  fprintf(stderr,"                            Parameters of the level name: icache,\n");
+  fprintf(stderr,"                            dcache, l1 (unified), l2cache, or l3 to\n");
+  fprintf(stderr,"                            l%d below the L2-cache. In multicore\n", MAX_OUTER_LEVELS + 2);
+  fprintf(stderr,"                            runs the levels from the first shared\n");
+  fprintf(stderr,"                            one down are shared (default: the L2)\n");
   fprintf(stderr," --inclusive                Makes L2-cache be inclusive\n");
+  fprintf(stderr," --l2policy=policy          Inclusion of the L1 lines in the\n");
+  fprintf(stderr,"                            L2-cache: inclusive, exclusive or\n");
+  fprintf(stderr,"                            nine, and report back-invalidations\n");
+  fprintf(stderr," --write-through            Write hits through to the next level\n");
+  fprintf(stderr,"                            (default: write-back)\n");
+  fprintf(stderr," --no-write-allocate        Send write misses to the next level\n");
+  fprintf(stderr,"                            (default: write-allocate)\n");
   fprintf(stderr," --blocksize=size           Block/Line size\n");
   fprintf(stderr," --memspeed=latency         Latency to Main Memory\n");
+  fprintf(stderr," --policy=[level:]name      Replacement policy of every level, or\n");
+  fprintf(stderr,"                            of one named as in --level: lru, plru,\n");
+  fprintf(stderr,"                            srrip, brrip, random or fifo\n");
+  fprintf(stderr," --index-hash=[level:]name  Set index function of every level,\n");
+  fprintf(stderr,"                            or of one: modulo, xor (folds the\n");
+  fprintf(stderr,"                            tag bits in) or skewed (one hash per\n");
+  fprintf(stderr,"                            way, lru only)\n");
+  fprintf(stderr," --prefetch=[level:]name[:degree[:distance]]\n");
+  fprintf(stderr,"                            Prefetcher of the dcache and l2cache,\n");
+  fprintf(stderr,"                            or of one of them: nextline, stride\n");
+  fprintf(stderr,"                            or stream (default: 1 line, 1 ahead)\n");
+  fprintf(stderr," --victim=[level:]entries:lat\n");
+  fprintf(stderr,"                            Fully associative victim cache behind\n");
+  fprintf(stderr,"                            the icache and dcache, or one of them\n");
+  fprintf(stderr," --mrc=ways                 L2 miss ratio curve for 1..ways ways\n");
+  fprintf(stderr,"                            with the L2 sets, in one pass\n");
+  fprintf(stderr,"                            (exact for a non-inclusive L2)\n");
+  fprintf(stderr," --interval=n               Record the statistics of every n\n");
+  fprintf(stderr,"                            accesses as CSV\n");
+  fprintf(stderr," --interval-file=file       Write the intervals to file\n");
+  fprintf(stderr,"                            (default: stderr)\n");
+  fprintf(stderr," --profile=prefix           Write per-set accesses and misses of\n");
+  fprintf(stderr,"                            every level to prefix-sets.csv and a\n");
+  fprintf(stderr,"                            reuse distance histogram of the trace\n");
+  fprintf(stderr,"                            to prefix-reuse.csv\n");
+  fprintf(stderr," --timing                   Estimate the cycles of the run with\n");
+  fprintf(stderr,"                            non-blocking caches\n");
+  fprintf(stderr," --mshr=[level:]n           MSHRs of the icache, dcache and\n");
+  fprintf(stderr,"                            l2cache, or of one, 0 blocks on a miss\n");
+  fprintf(stderr,"                            (default: 8 per L1, 16 in the L2)\n");
+  fprintf(stderr," --mem-interval=cycles      Cycles between lines read from memory\n");
+  fprintf(stderr,"                            (default: 0, no bandwidth limit)\n");
+  fprintf(stderr," --generic                  Do not use the compile-time kernels\n");
+  fprintf(stderr,"                            of the preset hierarchies\n");
+  fprintf(stderr," --sample-sets=fraction[:exact]\n");
+  fprintf(stderr,"                            Simulate a hashed fraction of the sets\n");
+  fprintf(stderr,"                            and estimate the statistics, with a\n");
+  fprintf(stderr,"                            full run to compare with (exact)\n");
+  fprintf(stderr,"                            that counts the values outside\n");
+  fprintf(stderr,"                            their 95%% interval\n");
+  fprintf(stderr," --convert=file[:delta]     Write the trace in binary format\n");
+  fprintf(stderr,"                            (raw or delta/varint encoded)\n");
+  fprintf(stderr," --config-file=file         Simulate one hierarchy per line of\n");
+  fprintf(stderr,"                            options in file, on top of the\n");
+  fprintf(stderr,"                            command line ones, in one pass\n");
+  fprintf(stderr," --save-state=file[:n]      Checkpoint the caches at the end of\n");
+  fprintf(stderr,"                            the run, or after n trace accesses\n");
+  fprintf(stderr," --load-state=file[:reset]  Start from a checkpoint of the same\n");
+  fprintf(stderr,"                            hierarchies and trace, after the\n");
+  fprintf(stderr,"                            accesses it covers (reset: zero the\n");
+  fprintf(stderr,"                            counters)\n");
+  fprintf(stderr," --threads=n                Worker threads for the sweep\n");
+  fprintf(stderr,"                            (default: one per core)\n");
+  fprintf(stderr," --multicore[=rr|time]      One core per trace with private I$, D$\n");
+  fprintf(stderr,"                            and upper levels over MESI-coherent\n");
+  fprintf(stderr,"                            shared levels, interleaved round-robin\n");
+  fprintf(stderr,"                            or by cycle\n");
+  fprintf(stderr," --quantum=n                Accesses (rr) or cycles (time) per core\n");
+  fprintf(stderr,"                            between coherence steps (default: 1000)\n");
+}
+
+// Strip the 'level:' prefix of '*arg', the level names of --level, and
+// list the levels it names in 'levels', all of them if there is no prefix.
+// l1 names both L1s
+// Returns the number of levels
+//
+static int
+levelPrefix(cache_config *cfg, const char **arg, level_config **levels)
+{
+  level_config *all[3 + MAX_OUTER_LEVELS] =
+      { &cfg->icache, &cfg->dcache, &cfg->l2cache };
+  const char *names[] = { "icache:", "dcache:", "l2cache:", "l1:", "l2:" };
+  const int from[] = { 0, 1, 2, 0, 2 }, to[] = { 0, 1, 2, 1, 2 };
+  int first = 0, last = 2 + MAX_OUTER_LEVELS;
+  for (int i = 0; i < MAX_OUTER_LEVELS; i++) {
+    all[3 + i] = &cfg->outer[i];
+  }
+  for (int i = 0; i < 5; i++) {
+    if (!strncmp(*arg, names[i], strlen(names[i]))) {
+      *arg += strlen(names[i]);
+      first = from[i];
+      last = to[i];
+    }
+  }
+  uint32_t depth;
+  int skip = 0;
+  if (last > 2 && sscanf(*arg, "l%u:%n", &depth, &skip) == 1 &&
+      skip > 0 && depth >= 3 && depth < MAX_OUTER_LEVELS + 3) {
+    *arg += skip;
+    first = last = depth;
+  }
+  for (int i = first; i <= last; i++) {
+    levels[i - first] = all[i];
+  }
+  return last - first + 1;
+}
+
+// Set the replacement policy from '[level:]name'
+//
+// Returns True if Successful
+//
+int
+handle_policy_option(cache_config *cfg, const char *arg)
+{
+  level_config *levels[3 + MAX_OUTER_LEVELS];
+  int n = levelPrefix(cfg, &arg, levels);
+  int policy = repl_parse(arg);
+  if (policy < 0) {
+    return 0;
+  }
+  for (int i = 0; i < n; i++) {
+    levels[i]->policy = policy;
+  }
+  return 1;
+}
+
+// Set the index hash from '[level:]name'
+//
+// Returns True if Successful
+//
+int
+handle_hash_option(cache_config *cfg, const char *arg)
+{
+  level_config *levels[3 + MAX_OUTER_LEVELS];
+  int n = levelPrefix(cfg, &arg, levels);
+  int hash = cache_hash_parse(arg);
+  if (hash < 0) {
+    return 0;
+  }
+  for (int i = 0; i < n; i++) {
+    levels[i]->hash = hash;
+  }
+  return 1;
+}
+
+// Set the MSHRs from '[level:]n', of the L1s and the L2-cache only
+//
+// Returns True if Successful
+//
+int
+handle_mshr_option(cache_config *cfg, const char *arg)
+{
+  level_config *levels[3 + MAX_OUTER_LEVELS];
+  int n = levelPrefix(cfg, &arg, levels);
+  uint32_t mshrs;
+  if (sscanf(arg, "%u", &mshrs) != 1 || mshrs > TIMING_MAX_MSHRS ||
+      (n == 1 && levels[0] >= cfg->outer)) {
+    return 0;
+  }
+  for (int i = 0; i < n && i < 3; i++) {
+    levels[i]->mshrs = mshrs;
+  }
+  return 1;
+}
+
+// Set the prefetcher from '[level:]name[:degree[:distance]]'
+//
+// Returns True if Successful
+//
+int
+handle_prefetch_option(cache_config *cfg, const char *arg)
+{
+  level_config *levels[] = { &cfg->dcache, &cfg->l2cache };
+  const char *names[] = { "dcache:", "l2cache:", "l1:", "l2:" };
+  int first = 0, last = 1;
+  for (int i = 0; i < 4; i++) {
+    if (!strncmp(arg, names[i], strlen(names[i]))) {
+      arg += strlen(names[i]);
+      first = last = i % 2;
+    }
+  }
+
+  char name[16];
+  uint32_t degree = 1, distance = 1;
+  if (sscanf(arg, "%15[a-z]:%u:%u", name, &degree, &distance) < 1) {
+    return 0;
+  }
+  int kind = pf_parse(name);
+  if (kind < 0 || degree < 1 || degree > PREFETCH_MAX_DEGREE) {
+    return 0;
+  }
+  for (int i = first; i <= last; i++) {
+    levels[i]->prefetch = kind;
+    levels[i]->prefetchDegree = degree;
+    levels[i]->prefetchDistance = distance;
+  }
+  return 1;
+}
+
+// Set a level from 'name:sets:assoc:hit[:shared]'
+//
+// Returns True if Successful
+//
+int
+handle_level_option(cache_config *cfg, const char *arg)
+{
+  char name[16], shared[16] = "";
+  uint32_t sets, assoc, hitTime, depth;
+  if (sscanf(arg, "%15[^:]:%u:%u:%u:%15s",
+             name, &sets, &assoc, &hitTime, shared) < 4) {
+    return 0;
+  }
+  if (shared[0] && strcmp(shared, "shared")) {
+    return 0;
+  }
+
+  level_config *l;
+  if (!strcmp(name, "icache")) {
+    l = &cfg->icache;
+  } else if (!strcmp(name, "dcache")) {
+    l = &cfg->dcache;
+  } else if (!strcmp(name, "l1")) {
+    l = &cfg->dcache;
+    cfg->unified = TRUE;
+  } else if (!strcmp(name, "l2cache") || !strcmp(name, "l2")) {
+    l = &cfg->l2cache;
+  } else if (sscanf(name, "l%u", &depth) == 1 && depth >= 3 &&
+             depth < MAX_OUTER_LEVELS + 3) {
+    l = &cfg->outer[depth - 3];
+    if (cfg->outerLevels < depth - 2) {
+      cfg->outerLevels = depth - 2;
+    }
+  } else {
+    return 0;
+  }
+  l->sets = sets;
+  l->assoc = assoc;
+  l->hitTime = hitTime;
+  l->shared = shared[0] != '\0';
+  return 1;
+}
+
+// Set the victim caches from '[level:]entries:lat'
+//
+// Returns True if Successful
+//
+int
+handle_victim_option(cache_config *cfg, const char *arg)
+{
+  level_config *levels[] = { &cfg->icache, &cfg->dcache };
+  const char *names[] = { "icache:", "dcache:", "l1:" };
+  int first = 0, last = 1;
+  for (int i = 0; i < 3; i++) {
+    if (!strncmp(arg, names[i], strlen(names[i]))) {
+      arg += strlen(names[i]);
+      first = i < 2 ? i : 0;
+      last = i < 2 ? i : 1;
+    }
+  }
+
+  uint32_t entries, hitTime;
+  if (sscanf(arg, "%u:%u", &entries, &hitTime) != 2) {
+    return 0;
+  }
+  for (int i = first; i <= last; i++) {
+    levels[i]->victimEntries = entries;
+    levels[i]->victimHitTime = hitTime;
+  }
+  return 1;
 }
 
 // Process an option and update the cache
-// configuration variables accordingly
+// configuration 'cfg' accordingly
 //
 // Returns True if Successful
 //
 int
-handle_option(char *arg)
+handle_cache_option(cache_config *cfg, const char *arg)
 {
   if (!strncmp(arg,"--icache=",9)) {
-    sscanf(arg+9,"%u:%u:%u", &icacheSets, &icacheAssoc, &icacheHitTime);
+    level_config *l = &cfg->icache;
+    sscanf(arg+9,"%u:%u:%u", &l->sets, &l->assoc, &l->hitTime);
   } else if (!strncmp(arg,"--dcache=",9)) {
-    sscanf(arg+9,"%u:%u:%u", &dcacheSets, &dcacheAssoc, &dcacheHitTime);
+    level_config *l = &cfg->dcache;
+    sscanf(arg+9,"%u:%u:%u", &l->sets, &l->assoc, &l->hitTime);
   } else if (!strncmp(arg,"--l2cache=",10)) {
-    sscanf(arg+10,"%u:%u:%u", &l2cacheSets, &l2cacheAssoc, &l2cacheHitTime);
+    level_config *l = &cfg->l2cache;
+    sscanf(arg+10,"%u:%u:%u", &l->sets, &l->assoc, &l->hitTime);
+  } else if (!strncmp(arg,"--level=",8)) {
+    return handle_level_option(cfg, arg+8);
   } else if (!strcmp(arg,"--inclusive")) {
-    inclusive = TRUE;
+    cfg->l2policy = L2_INCLUSIVE;
+  } else if (!strncmp(arg,"--l2policy=",11)) {
+    const char *names[] = { "nine", "inclusive", "exclusive" };
+    int policy = -1;
+    for (int i = 0; i < 3; i++) {
+      if (!strcmp(arg+11, names[i])) {
+        policy = i;
+      }
+    }
+    if (policy < 0) {
+      return 0;
+    }
+    cfg->l2policy = policy;
+    cfg->inclusionStats = TRUE;
+  } else if (!strcmp(arg,"--write-through")) {
+    cfg->writeThrough = TRUE;
+  } else if (!strcmp(arg,"--no-write-allocate")) {
+    cfg->noWriteAllocate = TRUE;
   } else if (!strncmp(arg,"--blocksize=",12)) {
-    sscanf(arg+12,"%u", &blocksize);
+    sscanf(arg+12,"%u", &cfg->blocksize);
   } else if (!strncmp(arg,"--memspeed=",11)) {
-    sscanf(arg+11,"%u", &memspeed);
+    sscanf(arg+11,"%u", &cfg->memspeed);
+  } else if (!strncmp(arg,"--policy=",9)) {
+    return handle_policy_option(cfg, arg+9);
+  } else if (!strncmp(arg,"--index-hash=",13)) {
+    return handle_hash_option(cfg, arg+13);
+  } else if (!strncmp(arg,"--prefetch=",11)) {
+    return handle_prefetch_option(cfg, arg+11);
+  } else if (!strcmp(arg,"--timing")) {
+    cfg->timing = TRUE;
+  } else if (!strncmp(arg,"--mshr=",7)) {
+    return handle_mshr_option(cfg, arg+7);
+  } else if (!strncmp(arg,"--mem-interval=",15)) {
+    sscanf(arg+15,"%u", &cfg->memInterval);
+  } else if (!strncmp(arg,"--victim=",9)) {
+    return handle_victim_option(cfg, arg+9);
+  } else if (!strncmp(arg,"--mrc=",6)) {
+    sscanf(arg+6,"%u", &cfg->mrcWays);
+  } else if (!strncmp(arg,"--interval=",11)) {
+    sscanf(arg+11,"%u", &cfg->interval);
+  } else if (!strcmp(arg,"--generic")) {
+    cfg->generic = TRUE;
+  } else if (!strncmp(arg,"--sample-sets=",14)) {
+    char mode[16] = "";
+    if (sscanf(arg+14,"%lf:%15s", &cfg->sampleSets, mode) < 1 ||
+        (mode[0] && strcmp(mode, "exact"))) {
+      return 0;
+    }
+    cfg->sampleExact = mode[0] != '\0';
+  } else {
+    return 0;
+  }
+
+  return 1;
+}
+
+// Process an option and update the simulator
+// configuration variables accordingly
+//
+// Returns True if Successful
+//
+int
+handle_option(char *arg)
+{
+  if (handle_cache_option(&config, arg)) {
+    return 1;
+  } else if (!strncmp(arg,"--config-file=",14)) {
+    configPath = arg+14;
+  } else if (!strncmp(arg,"--interval-file=",16)) {
+    intervalPath = arg+16;
+  } else if (!strncmp(arg,"--profile=",10)) {
+    profilePath = arg+10;
+    config.profile = TRUE;
+  } else if (!strncmp(arg,"--threads=",10)) {
+    sscanf(arg+10,"%d", &threads);
+  } else if (!strcmp(arg,"--multicore") || !strcmp(arg,"--multicore=rr")) {
+    multicoreRun = TRUE;
+    interleave = MC_ROUND_ROBIN;
+  } else if (!strcmp(arg,"--multicore=time")) {
+    multicoreRun = TRUE;
+    interleave = MC_TIMESTAMP;
+  } else if (!strncmp(arg,"--quantum=",10)) {
+    sscanf(arg+10,"%lu", &quantum);
+  } else if (!strncmp(arg,"--save-state=",13)) {
+    savePath = strdup(arg+13);
+    char *count = strrchr(savePath, ':');
+    if (count) {
+      *count = '\0';
+      if (sscanf(count+1,"%lu", &saveAfter) != 1) {
+        return 0;
+      }
+    }
+  } else if (!strncmp(arg,"--load-state=",13)) {
+    loadPath = strdup(arg+13);
+    char *mode = strrchr(loadPath, ':');
+    if (mode && !strcmp(mode, ":reset")) {
+      *mode = '\0';
+      loadReset = TRUE;
+    }
+  } else if (!strncmp(arg,"--convert=",10)) {
+    char *path = strdup(arg+10);
+    char *enc = strrchr(path, ':');
+    if (enc && !strcmp(enc, ":delta")) {
+      *enc = '\0';
+      convertEncoding = TRACE_DELTA;
+    }
+    convertPath = path;
   } else {
     return 0;
   }
@@ -66,90 +478,409 @@ printStudentInfo()
   printf("Student email:  %s\n", email);
 }
 
+void
+printPrefetchConfig(const level_config *l)
+{
+  if (l->prefetch != PREFETCH_NONE) {
+    printf("    Prefetch: %s, degree %u, distance %u\n",
+        pf_name(l->prefetch), l->prefetchDegree, l->prefetchDistance);
+  }
+}
+
+void
+printVictimConfig(const level_config *l)
+{
+  if (l->victimEntries) {
+    printf("    Victim: %u entries, %u Cycles\n",
+        l->victimEntries, l->victimHitTime);
+  }
+}
+
 // Print out the memory hierarchy
 //
 void
-printCacheConfig()
+printCacheConfig(const cache_config *c)
 {
+
   printf("Simulator Memory Hierarchy:\n");
   // Print I$ Configuration
-  if (icacheSets) {
+  if (c->icache.sets) {
     printf("  I$ Configuration:\n");
-    printf("    Size:  %u KB\n", icacheSets * icacheAssoc * blocksize / 1024);
-    printf("    Sets:  %u\n", icacheSets);
-    printf("    Assoc: %u\n", icacheAssoc);
-    printf("    Lat:   %u Cycles\n", icacheHitTime);
+    printf("    Size:  %u KB\n",
+        c->icache.sets * c->icache.assoc * c->blocksize / 1024);
+    printf("    Sets:  %u\n", c->icache.sets);
+    printf("    Assoc: %u\n", c->icache.assoc);
+    printf("    Lat:   %u Cycles\n", c->icache.hitTime);
+    if (c->icache.policy != POLICY_LRU) {
+      printf("    Policy: %s\n", repl_name(c->icache.policy));
+    }
+    if (c->icache.hash != HASH_MODULO) {
+      printf("    Index: %s\n", cache_hash_name(c->icache.hash));
+    }
+    printVictimConfig(&c->icache);
   }
   // Print D$ Configuration
-  if (dcacheSets) {
+  if (c->dcache.sets) {
     printf("  D$ Configuration:\n");
-    printf("    Size:  %u KB\n", dcacheSets * dcacheAssoc * blocksize / 1024);
-    printf("    Sets:  %u\n", dcacheSets);
-    printf("    Assoc: %u\n", dcacheAssoc);
-    printf("    Lat:   %u Cycles\n", dcacheHitTime);
+    printf("    Size:  %u KB\n",
+        c->dcache.sets * c->dcache.assoc * c->blocksize / 1024);
+    printf("    Sets:  %u\n", c->dcache.sets);
+    printf("    Assoc: %u\n", c->dcache.assoc);
+    printf("    Lat:   %u Cycles\n", c->dcache.hitTime);
+    if (c->dcache.policy != POLICY_LRU) {
+      printf("    Policy: %s\n", repl_name(c->dcache.policy));
+    }
+    if (c->dcache.hash != HASH_MODULO) {
+      printf("    Index: %s\n", cache_hash_name(c->dcache.hash));
+    }
+    if (c->unified) {
+      printf("    Unified: Yes\n");
+    }
+    printVictimConfig(&c->dcache);
+    printPrefetchConfig(&c->dcache);
   }
   // Print L2$ Configuration
-  if (l2cacheSets) {
+  if (c->l2cache.sets) {
     printf("  L2$ Configuration:\n");
-    printf("    Size:  %u KB\n", l2cacheSets * l2cacheAssoc * blocksize / 1024);
-    printf("    Sets:  %u\n", l2cacheSets);
-    printf("    Assoc: %u\n", l2cacheAssoc);
-    printf("    Lat:   %u Cycles\n", l2cacheHitTime);
-    printf("    Inclusive: %s\n", inclusive ? "Yes" : "No");
+    printf("    Size:  %u KB\n",
+        c->l2cache.sets * c->l2cache.assoc * c->blocksize / 1024);
+    printf("    Sets:  %u\n", c->l2cache.sets);
+    printf("    Assoc: %u\n", c->l2cache.assoc);
+    printf("    Lat:   %u Cycles\n", c->l2cache.hitTime);
+    if (c->l2cache.policy != POLICY_LRU) {
+      printf("    Policy: %s\n", repl_name(c->l2cache.policy));
+    }
+    if (c->l2cache.hash != HASH_MODULO) {
+      printf("    Index: %s\n", cache_hash_name(c->l2cache.hash));
+    }
+    printPrefetchConfig(&c->l2cache);
+    if (c->l2cache.shared) {
+      printf("    Shared: Yes\n");
+    }
+    if (c->l2policy == L2_EXCLUSIVE) {
+      printf("    Exclusive: Yes\n");
+    } else {
+      printf("    Inclusive: %s\n", c->l2policy == L2_INCLUSIVE ? "Yes" : "No");
+    }
+  }
+  // Print the Configuration of the levels below the L2$
+  for (uint32_t i = 0; i < c->outerLevels; i++) {
+    const level_config *l = &c->outer[i];
+    printf("  L%u$ Configuration:\n", i + 3);
+    printf("    Size:  %u KB\n", l->sets * l->assoc * c->blocksize / 1024);
+    printf("    Sets:  %u\n", l->sets);
+    printf("    Assoc: %u\n", l->assoc);
+    printf("    Lat:   %u Cycles\n", l->hitTime);
+    if (l->policy != POLICY_LRU) {
+      printf("    Policy: %s\n", repl_name(l->policy));
+    }
+    if (l->hash != HASH_MODULO) {
+      printf("    Index: %s\n", cache_hash_name(l->hash));
+    }
+    if (l->shared) {
+      printf("    Shared: Yes\n");
+    }
   }
-  printf("  Block Size: %u Bytes\n", blocksize);
-  printf("  Memspeed:   %u Cycles\n", memspeed);
+  if (c->writeThrough || c->noWriteAllocate) {
+    printf("  Writes:     %s, %s\n",
+        c->writeThrough ? "write-through" : "write-back",
+        c->noWriteAllocate ? "no-write-allocate" : "write-allocate");
+  }
+  printf("  Block Size: %u Bytes\n", c->blocksize);
+  printf("  Memspeed:   %u Cycles\n", c->memspeed);
+}
+
+// Print out the prefetch statistics of 'level', named 'name'
+//
+void
+printPrefetchStats(const cache_level *level, const char *name)
+{
+  const prefetch_stats *ps = pf_stats(level->prefetch);
+  char label[32];
+  snprintf(label, sizeof(label), "%s prefetches:", name);
+  printf("  %-25s%10lu\n", label, ps->issued);
+  snprintf(label, sizeof(label), "%s useful:", name);
+  printf("  %-25s%10lu\n", label, ps->useful);
+  snprintf(label, sizeof(label), "%s late:", name);
+  printf("  %-25s%10lu\n", label, ps->late);
+  snprintf(label, sizeof(label), "%s polluting:", name);
+  printf("  %-25s%10lu\n", label, ps->polluting);
+}
+
+// Print out the victim cache statistics of 'level', named 'name'
+//
+void
+printVictimStats(const cache_level *level, const char *name)
+{
+  const cache_level *vc = level->victim;
+  char label[32];
+  snprintf(label, sizeof(label), "%s victim probes:", name);
+  printf("  %-25s%10lu\n", label, vc->refs);
+  snprintf(label, sizeof(label), "%s victim hits:", name);
+  printf("  %-25s%10lu\n", label, vc->refs - vc->misses);
 }
 
 // Print out the Cache Statistics
 //
 void
-printCacheStats()
+printCacheStats(cache_sim *sim)
 {
+  const cache_level *ic = &sim->icache;
+  const cache_level *dc = &sim->dcache;
+  const cache_level *l2 = &sim->l2cache;
+
   printf("Cache Statistics:\n");
-  if (icacheSets) {
-    printf("  total I-cache accesses:  %10lu\n", icacheRefs);
-    printf("  total I-cache misses:    %10lu\n", icacheMisses);
-    printf("  total I-cache penalties: %10lu\n", icachePenalties);
-    if (icacheRefs > 0) {
+  if (ic->sets) {
+    printf("  total I-cache accesses:  %10lu\n", ic->refs);
+    printf("  total I-cache misses:    %10lu\n", ic->misses);
+    printf("  total I-cache penalties: %10lu\n", ic->penalties);
+    if (sim->config.inclusionStats) {
+      printf("  I-cache invalidations:   %10lu\n", ic->invalidations);
+    }
+    if (ic->victim) {
+      printVictimStats(ic, "I-cache");
+    }
+    if (ic->refs > 0) {
       printf("  I-cache miss rate:   %17.2f%%\n",
-          100.0*(double)icacheMisses/(double)icacheRefs);
+          100.0*(double)ic->misses/(double)ic->refs);
       printf("  avg I-cache access time: %13.2f cycles\n",
-          (double)((icachePenalties + icacheRefs * icacheHitTime))/icacheRefs);
+          (double)((ic->penalties + ic->refs * ic->hitTime))/ic->refs);
     } else {
       printf("  I-cache miss rate:                -\n");
       printf("  avg I-cache access time:          -\n");
     }
   }
-  if (dcacheSets) {
-    printf("  total D-cache accesses:  %10lu\n", dcacheRefs);
-    printf("  total D-cache misses:    %10lu\n", dcacheMisses);
-    printf("  total D-cache penalties: %10lu\n", dcachePenalties);
-    if (dcacheRefs > 0) {
+  if (dc->sets) {
+    printf("  total D-cache accesses:  %10lu\n", dc->refs);
+    printf("  total D-cache misses:    %10lu\n", dc->misses);
+    printf("  total D-cache penalties: %10lu\n", dc->penalties);
+    if (sim->config.inclusionStats) {
+      printf("  D-cache invalidations:   %10lu\n", dc->invalidations);
+    }
+    if (dc->writes || dc->writebacks) {
+      printf("  total D-cache writes:    %10lu\n", dc->writes);
+      printf("  total D-cache writebacks:%10lu\n", dc->writebacks);
+    }
+    if (dc->victim) {
+      printVictimStats(dc, "D-cache");
+    }
+    if (dc->prefetch) {
+      printPrefetchStats(dc, "D-cache");
+    }
+    if (dc->refs > 0) {
       printf("  D-cache miss rate:   %17.2f%%\n",
-          100.0*(double)dcacheMisses/(double)dcacheRefs);
+          100.0*(double)dc->misses/(double)dc->refs);
       printf("  avg D-cache access time: %13.2f cycles\n",
-          (double)((dcachePenalties + dcacheRefs * dcacheHitTime))/dcacheRefs);
+          (double)((dc->penalties + dc->refs * dc->hitTime))/dc->refs);
     } else {
       printf("  D-cache miss rate:                -\n");
       printf("  avg D-cache access time:          -\n");
     }
   }
-  if (l2cacheSets) {
-    printf("  total L2-cache accesses: %10lu\n", l2cacheRefs);
-    printf("  total L2-cache misses:   %10lu\n", l2cacheMisses);
-    printf("  total L2-cache penalties:%10lu\n", l2cachePenalties);
-    if (l2cacheRefs > 0) {
+  if (l2->sets) {
+    printf("  total L2-cache accesses: %10lu\n", l2->refs);
+    printf("  total L2-cache misses:   %10lu\n", l2->misses);
+    printf("  total L2-cache penalties:%10lu\n", l2->penalties);
+    if (l2->writes || l2->writebacks) {
+      printf("  total L2-cache writes:   %10lu\n", l2->writes);
+      printf("  total L2-cache writebacks:%9lu\n", l2->writebacks);
+    }
+    if (l2->prefetch) {
+      printPrefetchStats(l2, "L2-cache");
+    }
+    if (l2->refs > 0) {
       printf("  L2-cache miss rate:  %17.2f%%\n",
-          100.0*(double)l2cacheMisses/(double)l2cacheRefs);
+          100.0*(double)l2->misses/(double)l2->refs);
       printf("  avg L2-cache access time:%13.2f cycles\n",
-          (double)((l2cachePenalties + l2cacheHitTime * l2cacheRefs))
-          / l2cacheRefs);
+          (double)((l2->penalties + l2->hitTime * l2->refs))
+          / l2->refs);
     } else {
       printf("  L2-cache miss rate:               -\n");
       printf("  avg L2-cache access time:         -\n");
     }
   }
+  for (uint32_t i = 0; i < sim->config.outerLevels; i++) {
+    const cache_level *l = &sim->outer[i];
+    uint32_t n = i + 3;
+    if (!l->sets) {
+      continue;
+    }
+    printf("  total L%u-cache accesses: %10lu\n", n, l->refs);
+    printf("  total L%u-cache misses:   %10lu\n", n, l->misses);
+    printf("  total L%u-cache penalties:%10lu\n", n, l->penalties);
+    if (l->writes || l->writebacks) {
+      printf("  total L%u-cache writes:   %10lu\n", n, l->writes);
+      printf("  total L%u-cache writebacks:%9lu\n", n, l->writebacks);
+    }
+    if (l->refs > 0) {
+      printf("  L%u-cache miss rate:  %17.2f%%\n", n,
+          100.0*(double)l->misses/(double)l->refs);
+      printf("  avg L%u-cache access time:%13.2f cycles\n", n,
+          (double)((l->penalties + l->hitTime * l->refs))
+          / l->refs);
+    } else {
+      printf("  L%u-cache miss rate:               -\n", n);
+      printf("  avg L%u-cache access time:         -\n", n);
+    }
+  }
+}
+
+// Print out one estimated statistic, 'exact' is negative without a full run
+// Counts in 'checked' the exact values compared with an interval, and in
+// 'outside' those it misses, which are marked
+//
+void
+printEstimate(const char *label, sample_estimate e, double exact, int rate,
+              int *checked, int *outside)
+{
+  const char *unit = rate ? "%" : " ";
+  double scale = rate ? 100.0 : 1.0;
+  printf("  %-25s%13.2f%s +/- ", label, e.value * scale, unit);
+  if (isnan(e.error)) {
+    printf("%11s%s", "-", unit);
+  } else {
+    printf("%11.2f%s", e.error * scale, unit);
+  }
+  if (exact >= 0) {
+    printf(" %13.2f%s", exact * scale, unit);
+    if (exact > 0) {
+      printf(" %8.2f%%", 100.0 * (e.value - exact) / exact);
+    }
+    if (!isnan(e.error)) {
+      int miss = fabs(e.value - exact) > e.error + 1e-9 * exact;
+      *checked += 1;
+      *outside += miss;
+      if (miss) {
+        printf("  outside");
+      }
+    }
+  }
+  printf("\n");
+}
+
+// Print out the estimated statistics of the level 'level' named 'name'
+// of a set-sampled hierarchy, next to those of the full run 'exact'
+//
+void
+printLevelEstimates(const cache_sim *sim, const cache_level *level,
+                    const cache_level *exact, const char *name,
+                    int *checked, int *outside)
+{
+  char label[32];
+  snprintf(label, sizeof(label), "%s accesses:", name);
+  printEstimate(label, sample_count(sim, level, SAMPLE_REFS),
+      exact ? (double)exact->refs : -1, FALSE, checked, outside);
+  snprintf(label, sizeof(label), "%s misses:", name);
+  printEstimate(label, sample_count(sim, level, SAMPLE_MISSES),
+      exact ? (double)exact->misses : -1, FALSE, checked, outside);
+  snprintf(label, sizeof(label), "%s miss rate:", name);
+  printEstimate(label, sample_ratio(sim, level, SAMPLE_MISSES, SAMPLE_REFS),
+      exact && exact->refs ? (double)exact->misses / exact->refs : -1, TRUE,
+      checked, outside);
+}
+
+// Print out the estimated Cache Statistics of a set-sampled hierarchy,
+// with 95% confidence intervals
+//
+void
+printSampleStats(cache_sim *sim)
+{
+  const cache_sim *full = sample_exact(sim);
+  uint32_t sampled, groups;
+  sample_groups(sim->sampler, &sampled, &groups);
+
+  printf("Cache Statistics (estimated from %u of %u set groups):\n",
+      sampled, groups);
+  printf("  %-25s%14s %16s", "", "estimate", "95% interval");
+  if (full) {
+    printf(" %14s %9s", "exact", "error");
+  }
+  printf("\n");
+
+  const char *names[] = { "I-cache", "D-cache", "L2-cache" };
+  const cache_level *levels[] = { &sim->icache, &sim->dcache, &sim->l2cache };
+  const cache_level *exact[] = { full ? &full->icache : NULL,
+      full ? &full->dcache : NULL, full ? &full->l2cache : NULL };
+  int checked = 0, outside = 0;
+  for (int i = 0; i < 3; i++) {
+    if (levels[i]->sets) {
+      printLevelEstimates(sim, levels[i], exact[i], names[i], &checked,
+          &outside);
+    }
+  }
+  for (uint32_t i = 0; i < sim->config.outerLevels; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "L%u-cache", i + 3);
+    printLevelEstimates(sim, &sim->outer[i], full ? &full->outer[i] : NULL,
+        name, &checked, &outside);
+  }
+
+  printEstimate("Memory penalties:", sample_count(sim, NULL, SAMPLE_PENALTIES),
+      full ? (double)full->totalPenalties : -1, FALSE, &checked, &outside);
+  printEstimate("avg Memory access time:",
+      sample_ratio(sim, NULL, SAMPLE_PENALTIES, SAMPLE_REFS),
+      full && full->totalRefs ?
+      (double)full->totalPenalties / full->totalRefs : -1, FALSE, &checked,
+      &outside);
+  printf("Total Memory accesses:  %lu\n", sim->totalRefs);
+  if (full) {
+    printf("Exact values outside the 95%% interval: %d of %d\n", outside,
+        checked);
+  }
+}
+
+// Print out the L2 miss ratio curve
+//
+void
+printMissRatioCurve(cache_sim *sim)
+{
+  const cache_config *c = &sim->config;
+  uint32_t sets = 1 << sim->l2cache.indexBits;
+  uint64_t refs = sd_refs(sim->mrc);
+
+  printf("L2-cache Miss Ratio Curve (%u sets, LRU):\n", sets);
+  printf("  Assoc   Size KB      Misses   Miss rate\n");
+  for (uint32_t ways = 1; ways <= c->mrcWays; ways++) {
+    uint64_t misses = sd_misses(sim->mrc, ways);
+    printf("  %5u %9u %11lu", ways, sets * ways * c->blocksize / 1024, misses);
+    if (refs > 0) {
+      printf(" %10.2f%%\n", 100.0*(double)misses/(double)refs);
+    } else {
+      printf("          -\n");
+    }
+  }
+}
+
+// Print out the estimated cycles of the timing model
+//
+void
+printTimingStats(cache_sim *sim)
+{
+  const cache_config *c = &sim->config;
+  timing_stats ts = timing_report(sim);
+
+  printf("Timing Model:\n");
+  if (c->unified) {
+    printf("  MSHRs:      L1 %u, L2 %u\n", c->dcache.mshrs, c->l2cache.mshrs);
+  } else {
+    printf("  MSHRs:      I$ %u, D$ %u, L2 %u\n", c->icache.mshrs,
+        c->dcache.mshrs, c->l2cache.mshrs);
+  }
+  if (c->memInterval) {
+    printf("  Memory:     1 line every %u Cycles\n", c->memInterval);
+  }
+  printf("  %-25s%10lu\n", "Estimated cycles:", ts.cycles);
+  printf("  %-25s%10lu\n", "Serialized cycles:", sim->totalPenalties);
+  if (ts.cycles > 0) {
+    printf("  %-25s%10.2f\n", "Overlap:",
+        (double)sim->totalPenalties / ts.cycles);
+  } else {
+    printf("  %-25s%10s\n", "Overlap:", "-");
+  }
+  printf("  %-25s%10lu\n", "Merged misses:", ts.merged);
+  printf("  %-25s%10lu\n", "L1 MSHR stall cycles:", ts.mshrStalls);
+  printf("  %-25s%10lu\n", "L2 MSHR stall cycles:", ts.l2Stalls);
+  printf("  %-25s%10lu\n", "Bandwidth stall cycles:", ts.memStalls);
 }
 
 // Set the defaults for the Cache Simulator
@@ -157,39 +888,238 @@ printCacheStats()
 void
 set_defaults()
 {
-  // Set default input stream
-  stream = stdin;
-
   // Set default Cache Parameters
-  icacheSets      = 0;
-  icacheAssoc     = 0;
-  icacheHitTime   = 0;
-  dcacheSets      = 0;
-  dcacheAssoc     = 0;
-  dcacheHitTime   = 0;
-  l2cacheSets     = 0;
-  l2cacheAssoc    = 0;
-  l2cacheHitTime  = 0;
-  inclusive       = 0;
-  blocksize       = 16;
-  memspeed        = 50;
+  memset(&config, 0, sizeof(config));
+  config.l2policy   = L2_NINE;
+  config.blocksize  = 16;
+  config.memspeed   = 50;
+  config.icache.mshrs = config.dcache.mshrs = 8;
+  config.l2cache.mshrs = 16;
 }
 
-// Reads a line from the input stream and extracts the
-// Address and where the mem access should be directed to (I$ or D$)
+// Add a hierarchy built from 'cfg', described by 'name'
 //
-// Returns True if Successful 
+void
+add_sim(const cache_config *cfg, const char *name)
+{
+  sims = (cache_sim **)realloc(sims, (numSims + 1) * sizeof(cache_sim *));
+  simNames = (char **)realloc(simNames, (numSims + 1) * sizeof(char *));
+
+  // Keep each hierarchy on its own cache lines, they run on different cores
+  void *sim;
+  if (posix_memalign(&sim, 64, sizeof(cache_sim))) {
+    fprintf(stderr, "Unable to allocate configuration %d\n", numSims + 1);
+    exit(1);
+  }
+  sims[numSims] = (cache_sim *)sim;
+  init_cache(sims[numSims], cfg);
+  simNames[numSims] = strdup(name);
+  numSims++;
+}
+
+// Read one configuration per line of 'path'. Each line holds cache options
+// applied on top of the command line configuration, '#' starts a comment
 //
-int
-read_mem_access(uint32_t *addr, char *i_or_d)
+void
+read_config_file(const char *path)
 {
-  if (getline(&buf, &len, stream) == -1) {
-    return 0;
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    exit(1);
   }
 
-  sscanf(buf,"0x%x %c\n",addr,i_or_d);
+  char *line = NULL;
+  size_t len = 0;
+  int lineNo = 0;
+  while (getline(&line, &len, f) != -1) {
+    lineNo++;
+    char *comment = strchr(line, '#');
+    if (comment) {
+      *comment = '\0';
+    }
+    line[strcspn(line, "\r\n")] = '\0';
 
-  return 1;
+    cache_config cfg = config;
+    char *name = strdup(line);
+    int options = 0;
+    for (char *tok = strtok(line, " \t"); tok; tok = strtok(NULL, " \t")) {
+      if (!handle_cache_option(&cfg, tok)) {
+        fprintf(stderr,"%s:%d: Unrecognized option %s\n", path, lineNo, tok);
+        exit(1);
+      }
+      options++;
+    }
+    if (options) {
+      add_sim(&cfg, name + strspn(name, " \t"));
+    }
+    free(name);
+  }
+
+  free(line);
+  fclose(f);
+}
+
+// Print out the configuration and statistics of 'sim'
+//
+void
+printSimReport(cache_sim *sim)
+{
+  printCacheConfig(&sim->config);
+  if (sim->sampler) {
+    printSampleStats(sim);
+    return;
+  }
+  printCacheStats(sim);
+  printf("Total Memory accesses:  %lu\n", sim->totalRefs);
+  printf("Total Memory penalties: %lu\n", sim->totalPenalties);
+  if (sim->totalRefs > 0) {
+    printf("avg Memory access time: %13.2f cycles\n",
+        (double)sim->totalPenalties / sim->totalRefs);
+  } else {
+    printf("avg Memory access time:             -\n");
+  }
+  if (sim->mrc) {
+    printMissRatioCurve(sim);
+  }
+  if (sim->timing) {
+    printTimingStats(sim);
+  }
+}
+
+// Open the interval series of every hierarchy that records one, whose
+// rows are written as the run goes
+// Return the file they go to, or NULL if none records one
+//
+FILE *
+openIntervals()
+{
+  FILE *out = NULL;
+  for (int s = 0; s < numSims; s++) {
+    if (!sims[s]->config.interval) {
+      continue;
+    }
+    if (!out) {
+      out = intervalPath ? fopen(intervalPath, "w") : stderr;
+      if (!out) {
+        perror(intervalPath);
+        exit(1);
+      }
+      interval_header(out);
+    }
+    interval_open(sims[s], out, s + 1);
+  }
+  return out;
+}
+
+// Write the last partial intervals and close their file 'out'
+//
+void
+closeIntervals(FILE *out)
+{
+  for (int s = 0; s < numSims; s++) {
+    interval_close(sims[s]);
+  }
+  if (out && out != stderr) {
+    fclose(out);
+  }
+}
+
+// Open the profile file 'prefix-name' for writing
+//
+FILE *
+openProfile(const char *name)
+{
+  char *path = (char *)malloc(strlen(profilePath) + strlen(name) + 2);
+  sprintf(path, "%s-%s", profilePath, name);
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    exit(1);
+  }
+  free(path);
+  return out;
+}
+
+// Write the set counters and reuse histograms of every hierarchy
+//
+void
+writeProfiles()
+{
+  if (!profilePath) {
+    return;
+  }
+  FILE *sets = openProfile("sets.csv");
+  FILE *reuse = openProfile("reuse.csv");
+  profile_sets_header(sets);
+  profile_reuse_header(reuse);
+  for (int s = 0; s < numSims; s++) {
+    profile_write_sets(sets, sims[s], s + 1);
+    profile_write_reuse(reuse, sims[s], s + 1);
+  }
+  fclose(sets);
+  fclose(reuse);
+}
+
+// Print out the configuration and statistics of the multicore run 'mc'
+//
+void
+printMulticoreReport(multicore *mc)
+{
+  printf("Multicore: %d cores, %s interleaving, quantum %lu\n",
+      mc_cores(mc), interleave == MC_TIMESTAMP ? "timestamp" : "round-robin",
+      quantum);
+  printCacheConfig(&config);
+
+  uint64_t refs = 0, penalties = 0;
+  for (int c = 0; c < mc_cores(mc); c++) {
+    cache_sim *sim = mc_core_sim(mc, c);
+    const mc_stats *st = mc_core_stats(mc, c);
+    printf("Core %d: %s\n", c, tracePaths[c]);
+    printCacheStats(sim);
+    printf("  coherence misses:        %10lu\n", st->coherenceMisses);
+    printf("  invalidations:           %10lu\n", st->invalidations);
+    printf("  upgrades:                %10lu\n", st->upgrades);
+    printf("  downgrades:              %10lu\n", st->downgrades);
+    printf("  Memory accesses:         %10lu\n", sim->totalRefs);
+    printf("  Memory penalties:        %10lu\n", sim->totalPenalties);
+    refs += sim->totalRefs;
+    penalties += sim->totalPenalties;
+  }
+
+  printf("Shared Levels:\n");
+  printCacheStats(mc_shared_sim(mc));
+  printf("Total Memory accesses:  %lu\n", refs);
+  printf("Total Memory penalties: %lu\n", penalties);
+  if (refs > 0) {
+    printf("avg Memory access time: %13.2f cycles\n",
+        (double)penalties / refs);
+  } else {
+    printf("avg Memory access time:             -\n");
+  }
+}
+
+// Run one core per trace on the command line
+//
+int
+runMulticore()
+{
+  if (configPath || convertPath || profilePath) {
+    fprintf(stderr, "--multicore takes no --config-file, --convert or "
+            "--profile\n");
+    return 1;
+  }
+  multicore *mc = mc_create(&config, tracePaths, numTraces, interleave,
+                            quantum);
+  if (threads <= 0) {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  mc_run(mc, threads);
+
+  printStudentInfo();
+  printMulticoreReport(mc);
+  mc_free(mc);
+  return 0;
 }
 
 int
@@ -211,48 +1141,98 @@ main(int argc, char *argv[])
       }
     } else {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      tracePath = argv[i];
+      tracePaths = (char **)realloc(tracePaths, (numTraces + 1) * sizeof(char *));
+      tracePaths[numTraces++] = argv[i];
     }
   }
 
-  // Initialize the cache
-  init_cache();
+  if (multicoreRun) {
+    return runMulticore();
+  }
+  if (numTraces > 1) {
+    fprintf(stderr, "Only --multicore runs take more than one trace\n");
+    exit(1);
+  }
 
-  uint64_t totalRefs = 0;
-  uint64_t totalPenalties = 0;
-  uint32_t addr = 0;
-  char i_or_d = '\0';
+  trace input;
+  if (!trace_open(&input, tracePath)) {
+    perror(tracePath);
+    exit(1);
+  }
 
-  // Read each memory access from the trace
-  while (read_mem_access(&addr, &i_or_d)) {
-    totalRefs++;
-    // Direct the memory access to the appropriate cache
-    if (i_or_d == 'I') {
-      totalPenalties += icache_access(addr);
-    } else if (i_or_d == 'D') {
-      totalPenalties += dcache_access(addr);
-    } else {
-      fprintf(stderr,"Input Error '%c' must be either 'I' or 'D'\n", i_or_d);
+  // Only convert the trace to the binary format
+  if (convertPath) {
+    int ok = trace_convert(&input, convertPath, convertEncoding);
+    trace_close(&input);
+    return ok ? 0 : 1;
+  }
+
+  // Initialize the caches
+  if (configPath) {
+    read_config_file(configPath);
+  } else {
+    add_sim(&config, "");
+  }
+
+  // Keep the block offset and set index bits of every hierarchy in the
+  // compressed addresses
+  uint32_t regionBits = 0;
+  for (int s = 0; s < numSims; s++) {
+    if (cache_region_bits(sims[s]) > regionBits) {
+      regionBits = cache_region_bits(sims[s]);
+    }
+  }
+  addr_map *regions = addr_map_create(regionBits);
+  trace_set_regions(&input, regions);
+
+  // Resume from a checkpoint past the accesses it covers
+  uint64_t offset = 0;
+  if (loadPath) {
+    offset = checkpoint_load(loadPath, sims, numSims, loadReset);
+    if (trace_skip(&input, offset) != offset) {
+      fprintf(stderr, "Checkpoint %s: the trace ends before its %lu accesses\n",
+          loadPath, offset);
       exit(1);
     }
   }
+  if (saveAfter) {
+    trace_set_limit(&input, saveAfter);
+  }
+  uint64_t startRefs = sims[0]->totalRefs;
+  FILE *intervals = openIntervals();
+
+  // Read each memory access from the trace
+  if (threads <= 0) {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  sweep_run(&input, sims, numSims, threads);
+  closeIntervals(intervals);
+  if (savePath && !checkpoint_save(savePath, sims, numSims,
+                                   offset + sims[0]->totalRefs - startRefs)) {
+    exit(1);
+  }
 
   // Print out the statistics
   printStudentInfo();
-  printCacheConfig();
-  printCacheStats();
-  printf("Total Memory accesses:  %lu\n", totalRefs);
-  printf("Total Memory penalties: %lu\n", totalPenalties);
-  if (totalRefs > 0) {
-    printf("avg Memory access time: %13.2f cycles\n",
-        (double)totalPenalties / totalRefs);
-  } else {
-    printf("avg Memory access time:             -\n");
+  for (int s = 0; s < numSims; s++) {
+    if (configPath) {
+      printf("Configuration %d: %s\n", s + 1, simNames[s]);
+    }
+    printSimReport(sims[s]);
   }
+  writeProfiles();
 
   // Cleanup
-  fclose(stream);
-  free(buf);
+  trace_close(&input);
+  addr_map_free(regions);
+  for (int s = 0; s < numSims; s++) {
+    free_cache(sims[s]);
+    free(sims[s]);
+    free(simNames[s]);
+  }
+  free(sims);
+  free(simNames);
 
   return 0;
 }
@@ -0,0 +1,622 @@
+//========================================================//
+//  multicore.cpp                                         //
+//  Source file for the Multicore Simulation              //
+//                                                        //
+//  Quantum-synchronized core threads and the MESI        //
+//  directory of the shared levels                        //
+//========================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <unordered_map>
+#include "multicore.h"
+
+using namespace std;
+
+//------------------------------------//
+//       Multicore Structures         //
+//------------------------------------//
+
+#define MC_CHUNK 4096       // Accesses read from a trace at once
+
+enum { MC_READ, MC_WRITE, MC_UPGRADE, MC_EVICT };
+
+typedef struct {
+  uint64_t key;         // Position in the interleaving
+  uint32_t addr;        // Line address
+  uint8_t  type;
+  uint8_t  inst;        // From the I$
+  uint8_t  dirty;       // Evicted line was written
+} mc_event;
+
+struct mc_core {
+  cache_sim sim;        // Private levels
+  multicore *mc;
+  int id;
+  trace input;
+  mem_access *buffer;   // Accesses read from the trace
+  size_t count;
+  size_t next;
+  int done;             // The trace has ended
+
+  uint64_t key;         // Interleaving position of the current access
+  uint64_t accesses;    // Accesses simulated
+  uint64_t clock;       // Access time so far
+  vector<mc_event> events;  // Queued in the current quantum
+  mc_stats stats;
+};
+
+//
+// Directory entry of a line held by a private cache. Bit 2*core holds the
+// D$ of core, bit 2*core+1 its I$.
+//
+typedef struct {
+  uint64_t sharers;     // Private caches holding the line
+  uint64_t invalidated; // Private caches that lost the line to a write
+  int owner;            // Directory bit of the E or M copy, or -1
+} mc_line;
+
+struct multicore {
+  int cores;
+  int order;
+  uint64_t quantum;
+  uint64_t limit;       // End of the current quantum
+  vector<mc_core *> core;
+  cache_sim shared;     // Shared levels
+  cache_level *entry;   // First shared level, or NULL
+  int privateLevels;    // Levels of every core between its L1s and entry
+  addr_map *regions;    // Address compression of every trace
+  unordered_map<uint32_t, mc_line> directory;
+
+  // Quantum barrier of the worker threads and the merging thread
+  mutex lock;
+  condition_variable turn;
+  int waiting;
+  int parties;
+  uint64_t generation;
+  int finished;
+};
+
+//------------------------------------//
+//        Private Cache Hooks         //
+//------------------------------------//
+
+static void
+queue(mc_core *core, int type, int inst, uint32_t addr, int dirty)
+{
+  mc_event e;
+  e.key = core->key;
+  e.addr = addr >> core->sim.blockOffsetBits << core->sim.blockOffsetBits;
+  e.type = type;
+  e.inst = inst;
+  e.dirty = dirty != 0;
+  core->events.push_back(e);
+}
+
+void
+mc_fetch(mc_core *core, int inst, uint32_t addr, int write)
+{
+  queue(core, write ? MC_WRITE : MC_READ, inst, addr, 0);
+}
+
+void
+mc_upgrade(mc_core *core, uint32_t addr)
+{
+  queue(core, MC_UPGRADE, 0, addr, 0);
+}
+
+void
+mc_evict(mc_core *core, int inst, uint32_t addr, int dirty)
+{
+  queue(core, MC_EVICT, inst, addr, dirty);
+}
+
+// Read 'addr', or write it if 'write', in the shared levels
+// Return the access time
+//
+static inline uint32_t
+sharedAccess(multicore *mc, uint32_t addr, int write)
+{
+  if (!mc->entry) {
+    return mc->shared.config.memspeed;
+  }
+  return cache_level_access(&mc->shared, mc->entry, addr, write);
+}
+
+uint32_t
+mc_shared_access(mc_core *core, uint32_t addr, int write)
+{
+  return sharedAccess(core->mc, addr, write);
+}
+
+//------------------------------------//
+//        Directory Functions         //
+//------------------------------------//
+
+static inline cache_level *
+privateLevel(mc_core *core, int inst)
+{
+  return inst ? core->sim.ifetch : &core->sim.dcache;
+}
+
+// Read 'addr', or write it if 'write', below the L1s of 'core'
+// Return the access time
+//
+static inline uint32_t
+lowerAccess(multicore *mc, mc_core *core, uint32_t addr, int write)
+{
+  if (mc->privateLevels) {
+    cache_sim *sim = &core->sim;
+    return write ? l2cache_write(sim, addr) : l2cache_access(sim, addr);
+  }
+  return sharedAccess(mc, addr, write);
+}
+
+// Clear 'clear' from the copies of 'addr' in the private levels below the
+// L1s of every core but 'keep', writing dirty copies to the shared levels
+// Return the time taken by the writebacks and set *held if a copy was found
+//
+static uint32_t
+updateLower(multicore *mc, int keep, uint32_t addr, uint32_t clear,
+            int *held)
+{
+  uint32_t time = 0;
+  for (int c = 0; c < mc->cores; c++) {
+    mc_core *core = mc->core[c];
+    if (c == keep) {
+      continue;
+    }
+    for (int i = 0; i < mc->privateLevels; i++) {
+      cache_level *level = i ? &core->sim.outer[i - 1] : &core->sim.l2cache;
+      uint32_t old = cache_update_line(&core->sim, level, addr, 0, clear);
+      if (!(old & TAG_VALID)) {
+        continue;
+      }
+      *held = TRUE;
+      if (clear & TAG_VALID) {
+        core->stats.invalidations++;
+      }
+      if (old & TAG_DIRTY) {
+        if (!(clear & TAG_VALID)) {
+          core->stats.downgrades++;
+        }
+        level->writebacks++;
+        time += sharedAccess(mc, addr, TRUE);
+      }
+    }
+  }
+  return time;
+}
+
+// Demote the E or M copy of 'addr' held by directory bit 'owner' to S
+// Return the time taken by the writeback of an M copy
+//
+static uint32_t
+downgrade(multicore *mc, int owner, uint32_t addr)
+{
+  mc_core *core = mc->core[owner / 2];
+  uint32_t old = cache_update_line(&core->sim, privateLevel(core, owner & 1),
+                                   addr, TAG_SHARED, TAG_DIRTY);
+  if (!(old & TAG_VALID)) {
+    return 0;
+  }
+  core->stats.downgrades++;
+  if (old & TAG_DIRTY) {
+    core->sim.dcache.writebacks++;
+    return sharedAccess(mc, addr, TRUE);
+  }
+  return 0;
+}
+
+// Invalidate every copy of 'addr' in 'line' but the one of directory bit
+// 'keep'
+// Return the time taken by the writeback of an M copy
+//
+static uint32_t
+invalidateOthers(multicore *mc, mc_line *line, int keep, uint32_t addr)
+{
+  uint32_t time = 0;
+  uint64_t others = line->sharers & ~(1ull << keep);
+  while (others) {
+    int bit = __builtin_ctzll(others);
+    others &= others - 1;
+    mc_core *core = mc->core[bit / 2];
+    uint32_t old = cache_update_line(&core->sim, privateLevel(core, bit & 1),
+                                     addr, 0, TAG_VALID);
+    if (old & TAG_VALID) {
+      core->stats.invalidations++;
+      line->invalidated |= 1ull << bit;
+    }
+    if (old & TAG_DIRTY) {
+      core->sim.dcache.writebacks++;
+      time += sharedAccess(mc, addr, TRUE);
+    }
+  }
+  line->sharers &= 1ull << keep;
+  return time;
+}
+
+// Apply the event 'e' of 'core' to the directory and the shared levels
+//
+static void
+apply(multicore *mc, mc_core *core, const mc_event *e)
+{
+  int bit = 2 * core->id + e->inst;
+  mc_line *line = &mc->directory[e->addr];
+  if (line->sharers == 0 && line->invalidated == 0) {
+    // A new entry
+    line->owner = -1;
+  }
+
+  // An upgrade of a line invalidated since it was filled is a write miss
+  int type = e->type;
+  if (type == MC_UPGRADE && !(line->sharers & (1ull << bit))) {
+    type = MC_WRITE;
+  }
+  if (type != MC_EVICT && type != MC_UPGRADE &&
+      (line->invalidated & (1ull << bit))) {
+    core->stats.coherenceMisses++;
+  }
+  line->invalidated &= ~(1ull << bit);
+
+  uint32_t time = 0;
+  int held = FALSE;
+  switch (type) {
+    case MC_READ:
+      if (line->owner >= 0 && line->owner / 2 != core->id) {
+        time += downgrade(mc, line->owner, e->addr);
+        line->owner = -1;
+      }
+      if (mc->privateLevels) {
+        time += updateLower(mc, core->id, e->addr, TAG_DIRTY, &held);
+      }
+      time += lowerAccess(mc, core, e->addr, FALSE);
+      if (!(line->sharers & ~(1ull << bit)) && !held) {
+        // No other cache holds the line, grant E
+        cache_update_line(&core->sim, privateLevel(core, e->inst), e->addr,
+                          0, TAG_SHARED);
+        line->owner = bit;
+      }
+      line->sharers |= 1ull << bit;
+      break;
+    case MC_WRITE:
+    case MC_UPGRADE:
+      time += invalidateOthers(mc, line, bit, e->addr);
+      if (mc->privateLevels) {
+        time += updateLower(mc, core->id, e->addr, TAG_VALID, &held);
+      }
+      if (type == MC_WRITE) {
+        time += lowerAccess(mc, core, e->addr, FALSE);
+      } else if (line->owner != bit) {
+        // Writes to an E line granted since the fill are silent
+        core->stats.upgrades++;
+        time += mc->entry ? mc->entry->hitTime : 0;
+      }
+      line->sharers |= 1ull << bit;
+      line->owner = bit;
+      break;
+    case MC_EVICT:
+      line->sharers &= ~(1ull << bit);
+      if (line->owner == bit) {
+        line->owner = -1;
+      }
+      if (e->dirty) {
+        time += lowerAccess(mc, core, e->addr, TRUE);
+      }
+      break;
+  }
+  if (line->sharers == 0 && line->invalidated == 0) {
+    mc->directory.erase(e->addr);
+  }
+
+  // Charge the latency to the private level the event came from
+  privateLevel(core, e->inst)->penalties += time;
+  core->sim.totalPenalties += time;
+  core->clock += time;
+}
+
+// Apply the queued events of every core in interleaving order
+//
+static void
+merge(multicore *mc)
+{
+  vector<size_t> next(mc->cores, 0);
+  for (;;) {
+    mc_core *first = NULL;
+    for (int c = 0; c < mc->cores; c++) {
+      mc_core *core = mc->core[c];
+      if (next[c] < core->events.size() &&
+          (!first ||
+           core->events[next[c]].key < first->events[next[first->id]].key)) {
+        first = core;
+      }
+    }
+    if (!first) {
+      break;
+    }
+    apply(mc, first, &first->events[next[first->id]++]);
+  }
+  for (int c = 0; c < mc->cores; c++) {
+    mc->core[c]->events.clear();
+  }
+}
+
+//------------------------------------//
+//          Core Functions            //
+//------------------------------------//
+
+// Simulate the accesses of 'core' up to the end of the current quantum
+//
+static void
+step(multicore *mc, mc_core *core)
+{
+  cache_sim *sim = &core->sim;
+  int roundRobin = mc->order == MC_ROUND_ROBIN;
+  while (!core->done &&
+         (roundRobin ? core->accesses : core->clock) < mc->limit) {
+    if (core->next == core->count) {
+      core->count = trace_read(&core->input, core->buffer, MC_CHUNK);
+      core->next = 0;
+      if (core->count == 0) {
+        core->done = TRUE;
+        break;
+      }
+    }
+
+    const mem_access *a = &core->buffer[core->next++];
+    core->key = roundRobin ? core->accesses : core->clock;
+    uint32_t time;
+    if (a->type == 'I') {
+      time = icache_access(sim, a->addr);
+    } else if (a->type == 'W') {
+      time = dcache_write(sim, a->addr);
+    } else if (a->type == 'D') {
+      time = dcache_access(sim, a->addr);
+    } else {
+      fprintf(stderr,"Input Error '%c' must be either 'I', 'D' or 'W'\n",
+              a->type);
+      exit(1);
+    }
+    sim->totalRefs++;
+    sim->totalPenalties += time;
+    core->clock += time;
+    core->accesses++;
+  }
+}
+
+// Wait until every party has reached the barrier
+//
+static void
+barrier(multicore *mc)
+{
+  unique_lock<mutex> guard(mc->lock);
+  uint64_t generation = mc->generation;
+  if (++mc->waiting == mc->parties) {
+    mc->waiting = 0;
+    mc->generation++;
+    mc->turn.notify_all();
+  } else {
+    mc->turn.wait(guard, [mc, generation] {
+      return mc->generation != generation;
+    });
+  }
+}
+
+// Step the cores 'first', 'first' + 'stride', ... every quantum
+//
+static void
+work(multicore *mc, int first, int stride)
+{
+  for (;;) {
+    barrier(mc);
+    if (mc->finished) {
+      return;
+    }
+    for (int c = first; c < mc->cores; c += stride) {
+      step(mc, mc->core[c]);
+    }
+    barrier(mc);
+  }
+}
+
+//------------------------------------//
+//        Multicore Functions         //
+//------------------------------------//
+
+multicore *
+mc_create(const cache_config *config, char **paths, int cores, int order,
+          uint64_t quantum)
+{
+  // The levels below the L1s, the shared ones from 'first' on
+  const level_config *lower[1 + MAX_OUTER_LEVELS];
+  int levels = 0, first = -1, marked = 0;
+  if (config->l2cache.sets) {
+    lower[levels++] = &config->l2cache;
+    for (uint32_t i = 0; i < config->outerLevels; i++) {
+      lower[levels++] = &config->outer[i];
+    }
+  }
+  for (int i = 0; i < levels; i++) {
+    if (lower[i]->shared && first < 0) {
+      first = i;
+    }
+    marked += lower[i]->shared != 0;
+  }
+  if (first < 0) {
+    first = 0;
+  }
+
+  const char *err = NULL;
+  if (cores < 1 || cores > MC_MAX_CORES) {
+    err = "Multicore runs take 1 to 32 traces";
+  } else if (config->l2policy != L2_NINE) {
+    err = "Multicore runs need a non-inclusive L2";
+  } else if (config->writeThrough || config->noWriteAllocate) {
+    err = "Multicore runs need write-back, write-allocate caches";
+  } else if (config->icache.prefetch || config->dcache.prefetch ||
+             config->icache.victimEntries || config->dcache.victimEntries) {
+    err = "Multicore runs do not support L1 prefetchers or victim caches";
+  } else if (config->mrcWays || config->interval || config->timing) {
+    err = "Multicore runs do not support --mrc, --interval or --timing";
+  } else if (config->icache.shared || config->dcache.shared) {
+    err = "The L1 caches of multicore runs are private to each core";
+  } else if (marked && marked != levels - first) {
+    err = "The levels below a shared level must be shared too";
+  } else if (quantum == 0) {
+    err = "The quantum must be at least 1";
+  }
+  if (err) {
+    fprintf(stderr, "%s\n", err);
+    exit(1);
+  }
+
+  multicore *mc = new multicore();
+  mc->cores = cores;
+  mc->order = order;
+  mc->quantum = quantum;
+
+  // The private levels of every core and the shared levels below them
+  cache_config priv = *config;
+  if (first == 0) {
+    memset(&priv.l2cache, 0, sizeof(priv.l2cache));
+    priv.outerLevels = 0;
+  } else {
+    priv.outerLevels = first - 1;
+  }
+  priv.coherent = TRUE;
+  cache_config shared = *config;
+  memset(&shared.icache, 0, sizeof(shared.icache));
+  memset(&shared.dcache, 0, sizeof(shared.dcache));
+  shared.unified = FALSE;
+  init_cache(&mc->shared, &shared);
+  mc->privateLevels = first;
+  if (levels) {
+    mc->entry = first ? &mc->shared.outer[first - 1] : &mc->shared.l2cache;
+  }
+  // The private levels keep their place in the shared hierarchy, empty
+  for (int i = 0; i < first; i++) {
+    (i ? &mc->shared.outer[i - 1] : &mc->shared.l2cache)->sets = 0;
+  }
+
+  for (int c = 0; c < cores; c++) {
+    mc_core *core = new mc_core();
+    init_cache(&core->sim, &priv);
+    core->sim.core = core;
+    core->mc = mc;
+    core->id = c;
+    core->buffer = new mem_access[MC_CHUNK];
+    if (!trace_open(&core->input, paths[c])) {
+      perror(paths[c]);
+      exit(1);
+    }
+    mc->core.push_back(core);
+  }
+
+  // The traces share one map, so their regions never alias
+  uint32_t regionBits = cache_region_bits(&mc->shared);
+  if (cache_region_bits(&mc->core[0]->sim) > regionBits) {
+    regionBits = cache_region_bits(&mc->core[0]->sim);
+  }
+  mc->regions = addr_map_create(regionBits);
+  for (int c = 0; c < cores; c++) {
+    trace_set_regions(&mc->core[c]->input, mc->regions);
+  }
+  return mc;
+}
+
+void
+mc_free(multicore *mc)
+{
+  for (int c = 0; c < mc->cores; c++) {
+    mc_core *core = mc->core[c];
+    trace_close(&core->input);
+    free_cache(&core->sim);
+    delete[] core->buffer;
+    delete core;
+  }
+  free_cache(&mc->shared);
+  addr_map_free(mc->regions);
+  delete mc;
+}
+
+void
+mc_run(multicore *mc, int threads)
+{
+  if (threads > mc->cores) {
+    threads = mc->cores;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  // The merging thread steps the first share of the cores itself
+  mc->parties = threads;
+  vector<thread> workers;
+  for (int w = 1; w < threads; w++) {
+    workers.push_back(thread(work, mc, w, threads));
+  }
+
+  for (;;) {
+    int active = 0;
+    for (int c = 0; c < mc->cores; c++) {
+      active += !mc->core[c]->done;
+    }
+    if (!active) {
+      break;
+    }
+    mc->limit += mc->quantum;
+    if (mc->order == MC_TIMESTAMP) {
+      // Skip the quanta no core has reached
+      uint64_t earliest = UINT64_MAX;
+      for (int c = 0; c < mc->cores; c++) {
+        if (!mc->core[c]->done && mc->core[c]->clock < earliest) {
+          earliest = mc->core[c]->clock;
+        }
+      }
+      if (mc->limit <= earliest) {
+        mc->limit = earliest + mc->quantum;
+      }
+    }
+
+    barrier(mc);
+    for (int c = 0; c < mc->cores; c += threads) {
+      step(mc, mc->core[c]);
+    }
+    barrier(mc);
+    merge(mc);
+  }
+
+  mc->finished = TRUE;
+  barrier(mc);
+  for (size_t w = 0; w < workers.size(); w++) {
+    workers[w].join();
+  }
+}
+
+int
+mc_cores(const multicore *mc)
+{
+  return mc->cores;
+}
+
+cache_sim *
+mc_core_sim(multicore *mc, int core)
+{
+  return &mc->core[core]->sim;
+}
+
+const mc_stats *
+mc_core_stats(const multicore *mc, int core)
+{
+  return &mc->core[core]->stats;
+}
+
+cache_sim *
+mc_shared_sim(multicore *mc)
+{
+  return &mc->shared;
+}
@@ -0,0 +1,111 @@
+//========================================================//
+//  multicore.h                                           //
+//  Header file for the Multicore Simulation              //
+//                                                        //
+//  One trace per core through private I$, D$ and upper   //
+//  levels over shared lower levels kept coherent by a    //
+//  MESI directory                                        //
+//========================================================//
+
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include "cache.h"
+
+//
+// The cores run in quanta. Within a quantum each core simulates its own
+// trace on its private caches, on its own worker thread. Accesses that
+// need the shared levels or the directory (misses, upgrades of shared
+// lines and evictions) are queued as events, filled in the private cache
+// right away and charged no latency yet. At the end of the quantum the
+// events of all cores are merged in interleaving order and applied one
+// at a time to the directory and the shared levels. The latencies they
+// return are charged to the private level that missed, and the
+// invalidations and downgrades they cause are applied to the other cores.
+// The results are deterministic for any number of threads, but
+// coherence actions only reach the other cores at quantum boundaries.
+//
+// Round-robin interleaving orders events by (access number, core) and a
+// quantum is a number of accesses per core. Timestamp interleaving orders
+// them by (cycle, core) and a quantum is a number of cycles.
+//
+// The levels from the first one marked shared down are shared by the
+// cores, the L2 and below if none is. The levels between the L1s and the
+// shared ones are private to each core and filter the misses of its L1s
+// when the events are applied. The directory tracks the L1 copies only:
+// the private levels below them are looked up at every read, which cleans
+// their dirty copies and keeps their core from being granted E, and at
+// every write, which invalidates them.
+//
+// Private lines carry their MESI state in the tag flags:
+// M is TAG_DIRTY, S is TAG_SHARED, E has neither. Lines filled by a read
+// miss are S until the directory grants E at the end of the quantum, so
+// a write to them always queues an upgrade.
+//
+
+#define MC_MAX_CORES 32     // Two directory bits per core, I$ and D$
+
+enum { MC_ROUND_ROBIN, MC_TIMESTAMP };
+
+typedef struct {
+  uint64_t coherenceMisses; // Misses on lines lost to an invalidation
+  uint64_t invalidations;   // Private lines invalidated by other writes
+  uint64_t upgrades;        // Writes to shared lines
+  uint64_t downgrades;      // M or E lines demoted by other reads
+} mc_stats;
+
+struct multicore;
+struct mc_core;
+
+//------------------------------------//
+//   Multicore Function Prototypes    //
+//------------------------------------//
+
+// Create a run of one core per trace in 'paths' over the hierarchy
+// 'config', interleaved by 'order' in quanta of 'quantum'
+// Exits with a message if 'config' has a feature multicore runs lack
+//
+multicore *mc_create(const cache_config *config, char **paths, int cores,
+                     int order, uint64_t quantum);
+
+void mc_free(multicore *mc);
+
+// Run every trace to its end with up to 'threads' worker threads
+//
+void mc_run(multicore *mc, int threads);
+
+int mc_cores(const multicore *mc);
+
+// The private levels of 'core'
+//
+cache_sim *mc_core_sim(multicore *mc, int core);
+
+const mc_stats *mc_core_stats(const multicore *mc, int core);
+
+// The shared levels, its I$, D$ and private levels are empty
+//
+cache_sim *mc_shared_sim(multicore *mc);
+
+//------------------------------------//
+//        Private Cache Hooks         //
+//------------------------------------//
+
+// Queue a miss of the I$ ('inst') or D$ on 'addr' by 'core'
+//
+void mc_fetch(mc_core *core, int inst, uint32_t addr, int write);
+
+// Queue a write to the shared line 'addr'
+//
+void mc_upgrade(mc_core *core, uint32_t addr);
+
+// Queue the eviction of the line 'addr' from the I$ or D$ of 'core'
+//
+void mc_evict(mc_core *core, int inst, uint32_t addr, int dirty);
+
+// Read 'addr', or write it if 'write', in the shared levels for the last
+// private level below the L1s of 'core'
+// Return the access time
+//
+uint32_t mc_shared_access(mc_core *core, uint32_t addr, int write);
+
+#endif
@@ -0,0 +1,268 @@
+//========================================================//
+//  prefetch.cpp                                          //
+//  Source file for the Hardware Prefetchers              //
+//                                                        //
+//  Address-keyed stride table, stream table and the      //
+//  in-flight/eviction filters behind the statistics      //
+//========================================================//
+
+#include <stdlib.h>
+#include <string.h>
+#include "prefetch.h"
+
+//------------------------------------//
+//       Prefetcher Structures        //
+//------------------------------------//
+
+#define STRIDE_ENTRIES   64     // Stride table, one entry per 4KB region
+#define STREAM_ENTRIES   16     // Tracked streams
+#define INFLIGHT_ENTRIES 256    // Recent fills and their completion time
+#define EVICTED_ENTRIES  1024   // Demand lines evicted by prefetch fills
+#define CONFIDENT        2      // Confirmations before a stride/stream issues
+
+//
+// There is no PC in the trace, so the stride table is keyed by the 4KB
+// region of the access instead: every region remembers its last line and
+// stride, which works for the array walks that dominate our traces.
+//
+// Time is the sum of the access times of the demand accesses the level
+// has seen, a fill issued at time t with latency l completes at t + l.
+//
+typedef struct {
+  uint32_t region;      // Region + 1, 0 for a free entry
+  uint32_t last;        // Last line accessed in the region
+  int32_t  stride;      // In lines
+  uint32_t conf;        // Saturating confirmations of 'stride'
+} stride_entry;
+
+typedef struct {
+  uint32_t last;        // Last line of the stream
+  int32_t  dir;         // +1 ascending, -1 descending, 0 untrained
+  uint32_t conf;        // Saturating confirmations of 'dir'
+  uint64_t used;        // Time of the last trigger, for replacement
+} stream_entry;
+
+typedef struct {
+  uint32_t line;
+  uint64_t ready;       // Completion time
+} inflight_entry;
+
+struct prefetcher {
+  uint32_t kind;
+  uint32_t degree;
+  uint32_t distance;
+  uint32_t pageShift;   // Line number bits above the page
+
+  uint64_t clock;
+  stride_entry   strides[STRIDE_ENTRIES];
+  stream_entry   streams[STREAM_ENTRIES];
+  inflight_entry inflight[INFLIGHT_ENTRIES];
+  uint32_t       evicted[EVICTED_ENTRIES];   // Line + 1, 0 for none
+
+  prefetch_stats stats;
+};
+
+static const char *prefetchNames[] = {
+  "none", "nextline", "stride", "stream"
+};
+
+//------------------------------------//
+//        Prefetcher Helpers          //
+//------------------------------------//
+
+// Append the 'degree' lines 'start', 'start' + 'step', ... of the page of
+// 'line' to 'out'
+//
+static uint32_t
+pf_run(const prefetcher *pf, uint32_t line, int64_t start, int32_t step,
+       uint32_t *out)
+{
+  uint32_t n = 0;
+  for (uint32_t k = 0; k < pf->degree; k++) {
+    int64_t target = start + (int64_t)step * k;
+    if (target < 0 || (target >> pf->pageShift) != (line >> pf->pageShift)) {
+      break;
+    }
+    out[n++] = (uint32_t)target;
+  }
+  return n;
+}
+
+static uint32_t
+train_stride(prefetcher *pf, uint32_t line, uint32_t *out)
+{
+  uint32_t region = line >> pf->pageShift;
+  stride_entry *e = &pf->strides[region % STRIDE_ENTRIES];
+  if (e->region != region + 1) {
+    e->region = region + 1;
+    e->last = line;
+    e->stride = 0;
+    e->conf = 0;
+    return 0;
+  }
+
+  int32_t stride = (int32_t)(line - e->last);
+  if (stride == 0) {
+    return 0;
+  }
+  if (stride == e->stride) {
+    e->conf += e->conf < 3;
+  } else if (e->conf > 0) {
+    e->conf--;
+  } else {
+    e->stride = stride;
+  }
+  e->last = line;
+
+  if (e->conf < CONFIDENT) {
+    return 0;
+  }
+  return pf_run(pf, line, (int64_t)line + (int64_t)e->stride * pf->distance,
+                e->stride, out);
+}
+
+static uint32_t
+train_stream(prefetcher *pf, uint32_t line, uint32_t *out)
+{
+  stream_entry *s = NULL, *oldest = &pf->streams[0];
+  for (int i = 0; i < STREAM_ENTRIES; i++) {
+    stream_entry *e = &pf->streams[i];
+    // Within two lines of the end of a stream
+    if (e->used && line != e->last && line - e->last + 2 <= 4) {
+      s = e;
+      break;
+    }
+    if (e->used < oldest->used) {
+      oldest = e;
+    }
+  }
+
+  if (!s) {
+    oldest->last = line;
+    oldest->dir = 0;
+    oldest->conf = 0;
+    oldest->used = pf->clock + 1;
+    return 0;
+  }
+
+  int32_t dir = line > s->last ? 1 : -1;
+  if (dir == s->dir) {
+    s->conf += s->conf < 3;
+  } else {
+    s->dir = dir;
+    s->conf = 1;
+  }
+  s->last = line;
+  s->used = pf->clock + 1;
+
+  if (s->conf < CONFIDENT) {
+    return 0;
+  }
+  return pf_run(pf, line, (int64_t)line + dir * (int64_t)pf->distance, dir,
+                out);
+}
+
+//------------------------------------//
+//       Prefetcher Functions         //
+//------------------------------------//
+
+int
+pf_parse(const char *name)
+{
+  for (int k = 0; k < PREFETCH_COUNT; k++) {
+    if (!strcmp(name, prefetchNames[k])) {
+      return k;
+    }
+  }
+  return -1;
+}
+
+const char *
+pf_name(uint32_t kind)
+{
+  return kind < PREFETCH_COUNT ? prefetchNames[kind] : "?";
+}
+
+prefetcher *
+pf_create(uint32_t kind, uint32_t offsetBits, uint32_t degree,
+          uint32_t distance)
+{
+  prefetcher *pf = (prefetcher *)calloc(1, sizeof(prefetcher));
+  if (!pf) {
+    return NULL;
+  }
+  pf->kind = kind;
+  pf->degree = degree < PREFETCH_MAX_DEGREE ? degree : PREFETCH_MAX_DEGREE;
+  pf->distance = distance;
+  pf->pageShift = offsetBits < PREFETCH_PAGE_BITS ?
+                  PREFETCH_PAGE_BITS - offsetBits : 0;
+  return pf;
+}
+
+void
+pf_free(prefetcher *pf)
+{
+  free(pf);
+}
+
+uint32_t
+pf_train(prefetcher *pf, uint32_t line, uint32_t time, int trigger,
+         uint32_t out[PREFETCH_MAX_DEGREE])
+{
+  pf->clock += time;
+  switch (pf->kind) {
+    case PREFETCH_NEXTLINE:
+      if (!trigger) {
+        return 0;
+      }
+      return pf_run(pf, line, (int64_t)line + pf->distance, 1, out);
+    case PREFETCH_STRIDE:
+      return train_stride(pf, line, out);
+    case PREFETCH_STREAM:
+      return trigger ? train_stream(pf, line, out) : 0;
+  }
+  return 0;
+}
+
+void
+pf_issue(prefetcher *pf, uint32_t line, uint32_t latency)
+{
+  inflight_entry *e = &pf->inflight[line % INFLIGHT_ENTRIES];
+  e->line = line;
+  e->ready = pf->clock + latency;
+  pf->stats.issued++;
+}
+
+uint32_t
+pf_hit(prefetcher *pf, uint32_t line)
+{
+  pf->stats.useful++;
+  inflight_entry *e = &pf->inflight[line % INFLIGHT_ENTRIES];
+  if (e->line == line && e->ready > pf->clock) {
+    pf->stats.late++;
+    return e->ready - pf->clock;
+  }
+  return 0;
+}
+
+void
+pf_evict(prefetcher *pf, uint32_t line)
+{
+  pf->evicted[line % EVICTED_ENTRIES] = line + 1;
+}
+
+void
+pf_miss(prefetcher *pf, uint32_t line)
+{
+  uint32_t *e = &pf->evicted[line % EVICTED_ENTRIES];
+  if (*e == line + 1) {
+    pf->stats.polluting++;
+    *e = 0;
+  }
+}
+
+const prefetch_stats *
+pf_stats(const prefetcher *pf)
+{
+  return &pf->stats;
+}
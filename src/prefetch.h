@@ -0,0 +1,86 @@
+//========================================================//
+//  prefetch.h                                            //
+//  Header file for the Hardware Prefetchers              //
+//                                                        //
+//  Next-line, stride and stream prefetchers that train   //
+//  on the demand accesses of one cache level             //
+//========================================================//
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdint.h>
+
+//------------------------------------//
+//      Prefetcher Configuration      //
+//------------------------------------//
+
+enum {
+  PREFETCH_NONE, PREFETCH_NEXTLINE, PREFETCH_STRIDE, PREFETCH_STREAM,
+  PREFETCH_COUNT
+};
+
+#define PREFETCH_MAX_DEGREE 16  // Lines issued per trigger at most
+#define PREFETCH_PAGE_BITS  12  // Prefetches never cross a 4KB page
+
+//
+// Prefetch Statistics:
+// issued     lines filled by the prefetcher
+// useful     prefetched lines hit by a demand access before eviction
+// late       useful prefetches whose fill had not completed yet
+// polluting  demand misses on lines a prefetch fill had evicted
+//
+typedef struct {
+  uint64_t issued;
+  uint64_t useful;
+  uint64_t late;
+  uint64_t polluting;
+} prefetch_stats;
+
+struct prefetcher;
+
+//------------------------------------//
+//    Prefetcher Function Prototypes  //
+//------------------------------------//
+
+// Return the prefetcher called 'name', or -1 if there is none
+//
+int pf_parse(const char *name);
+
+const char *pf_name(uint32_t kind);
+
+// Create a prefetcher of 'kind' for 2^'offsetBits' byte lines, fetching
+// 'degree' lines 'distance' lines (or strides) ahead of the trigger
+//
+prefetcher *pf_create(uint32_t kind, uint32_t offsetBits, uint32_t degree,
+                      uint32_t distance);
+
+void pf_free(prefetcher *pf);
+
+// Train on a demand access to 'line' that took 'time' cycles. 'trigger'
+// is set for misses and first hits to prefetched lines.
+// Writes the lines to prefetch to 'out' and returns their number
+//
+uint32_t pf_train(prefetcher *pf, uint32_t line, uint32_t time,
+                  int trigger, uint32_t out[PREFETCH_MAX_DEGREE]);
+
+// Record the fill of 'line', available in 'latency' cycles
+//
+void pf_issue(prefetcher *pf, uint32_t line, uint32_t latency);
+
+// Record the first demand hit to the prefetched 'line'
+// Returns the cycles left until its fill completes, 0 if it has
+//
+uint32_t pf_hit(prefetcher *pf, uint32_t line);
+
+// Record that a prefetch fill evicted the demand 'line'
+//
+void pf_evict(prefetcher *pf, uint32_t line);
+
+// Record a demand miss on 'line', counting it if a prefetch evicted it
+//
+void pf_miss(prefetcher *pf, uint32_t line);
+
+const prefetch_stats *pf_stats(const prefetcher *pf);
+
+#endif
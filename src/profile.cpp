@@ -0,0 +1,171 @@
+//========================================================//
+//  profile.cpp                                           //
+//  Source file for the Set and Reuse Profiles            //
+//                                                        //
+//  Reuse distances from a one set stack distance engine  //
+//  bucketed by their highest bit                         //
+//========================================================//
+
+#include <string.h>
+#include "profile.h"
+
+#define PROFILE_LEVELS (3 + MAX_OUTER_LEVELS)
+
+//------------------------------------//
+//        Profile Structures          //
+//------------------------------------//
+
+struct cache_profile {
+  stack_dist *reuse;    // Fully associative, one set
+  uint64_t buckets[PROFILE_BUCKETS];
+  uint64_t cold;        // First accesses to their line
+};
+
+//------------------------------------//
+//          Profile Helpers           //
+//------------------------------------//
+
+static void
+profile_error(const char *what)
+{
+  fprintf(stderr, "Profiling %s\n", what);
+  exit(1);
+}
+
+// List the levels of 'sim' with sets and set their names
+// Returns the number of levels
+//
+static int
+levelList(const cache_sim *sim, const cache_level **out, char names[][16])
+{
+  const cache_level *all[PROFILE_LEVELS] =
+      { &sim->icache, &sim->dcache, &sim->l2cache };
+  for (uint32_t i = 0; i < sim->config.outerLevels; i++) {
+    all[3 + i] = &sim->outer[i];
+  }
+  int n = 0;
+  for (uint32_t i = 0; i < 3 + sim->config.outerLevels; i++) {
+    if (all[i]->sets) {
+      if (i < 2) {
+        snprintf(names[n], 16, "%s", i == 0 ? "I-cache" : "D-cache");
+      } else {
+        snprintf(names[n], 16, "L%u-cache", i);
+      }
+      out[n++] = all[i];
+    }
+  }
+  return n;
+}
+
+//------------------------------------//
+//         Profile Functions          //
+//------------------------------------//
+
+cache_profile *
+profile_create(cache_sim *sim)
+{
+  const cache_config *c = &sim->config;
+  if (c->coherent || c->sampleSets) {
+    profile_error("does not support --sample-sets or multicore runs");
+  }
+
+  const cache_level *levels[PROFILE_LEVELS];
+  char names[PROFILE_LEVELS][16];
+  int n = levelList(sim, levels, names);
+  for (int i = 0; i < n; i++) {
+    cache_level *l = (cache_level *)levels[i];
+    uint64_t sets = (uint64_t)1 << l->indexBits;
+    l->setCounts = (uint64_t *)calloc(sets * PROFILE_COUNTERS,
+                                      sizeof(uint64_t));
+    if (!l->setCounts) {
+      profile_error("cannot allocate the set counters");
+    }
+  }
+
+  cache_profile *p = new cache_profile();
+  p->reuse = sd_create(0, sim->blockOffsetBits, 1);
+  return p;
+}
+
+void
+profile_free(cache_sim *sim)
+{
+  const cache_level *levels[PROFILE_LEVELS];
+  char names[PROFILE_LEVELS][16];
+  int n = levelList(sim, levels, names);
+  for (int i = 0; i < n; i++) {
+    cache_level *l = (cache_level *)levels[i];
+    free(l->setCounts);
+    l->setCounts = NULL;
+  }
+  sd_free(sim->profile->reuse);
+  delete sim->profile;
+  sim->profile = NULL;
+}
+
+void
+profile_batch(cache_profile *p, const mem_access *batch, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    uint32_t dist = sd_access(p->reuse, batch[i].addr);
+    if (dist == SD_COLD) {
+      p->cold++;
+    } else {
+      p->buckets[dist ? 32 - __builtin_clz(dist) : 0]++;
+    }
+  }
+}
+
+void
+profile_sets_header(FILE *out)
+{
+  fprintf(out, "config,level,set,accesses,misses,miss_rate\n");
+}
+
+void
+profile_reuse_header(FILE *out)
+{
+  fprintf(out, "config,bucket,min_distance,max_distance,accesses,fraction\n");
+}
+
+void
+profile_write_sets(FILE *out, const cache_sim *sim, int config)
+{
+  const cache_level *levels[PROFILE_LEVELS];
+  char names[PROFILE_LEVELS][16];
+  int n = levelList(sim, levels, names);
+  for (int i = 0; i < n; i++) {
+    const cache_level *l = levels[i];
+    for (uint32_t s = 0; s < l->sets; s++) {
+      uint64_t refs = l->setCounts[(uint64_t)s * PROFILE_COUNTERS +
+                                   PROFILE_REFS];
+      uint64_t misses = l->setCounts[(uint64_t)s * PROFILE_COUNTERS +
+                                     PROFILE_MISSES];
+      fprintf(out, "%d,%s,%u,%lu,%lu,%.6f\n", config, names[i], s, refs,
+          misses, refs ? (double)misses / refs : 0.0);
+    }
+  }
+}
+
+void
+profile_write_reuse(FILE *out, const cache_sim *sim, int config)
+{
+  const cache_profile *p = sim->profile;
+  uint64_t total = p->cold;
+  int last = -1;
+  for (int k = 0; k < PROFILE_BUCKETS; k++) {
+    total += p->buckets[k];
+    if (p->buckets[k]) {
+      last = k;
+    }
+  }
+
+  for (int k = 0; k <= last; k++) {
+    uint64_t lo = k ? (uint64_t)1 << (k - 1) : 0;
+    uint64_t hi = k ? ((uint64_t)1 << k) - 1 : 0;
+    fprintf(out, "%d,%d,%lu,%lu,%lu,%.6f\n", config, k, lo, hi,
+        p->buckets[k], total ? (double)p->buckets[k] / total : 0.0);
+  }
+  fprintf(out, "%d,cold,,,%lu,%.6f\n", config, p->cold,
+      total ? (double)p->cold / total : 0.0);
+}
@@ -0,0 +1,62 @@
+//========================================================//
+//  profile.h                                             //
+//  Header file for the Set and Reuse Profiles            //
+//                                                        //
+//  Counts the accesses and misses of every set of every  //
+//  level and the reuse distances of the trace, written   //
+//  as CSV                                                //
+//========================================================//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include "cache.h"
+
+//
+// Every level gets a flat array of PROFILE_COUNTERS counters per set,
+// bumped next to its refs and misses counters. Victim caches are not
+// profiled, they have a single set.
+//
+// The reuse distance of an access is the number of distinct lines
+// referenced since the previous access to its line, over the whole trace
+// at the block size of the hierarchy. It does not depend on the caches,
+// so it is taken over each batch before the batch is simulated. The
+// histogram has one bucket for distance 0, then one per power of two:
+// bucket k holds the distances in [2^(k-1), 2^k).
+//
+enum { PROFILE_REFS, PROFILE_MISSES, PROFILE_COUNTERS };
+
+#define PROFILE_BUCKETS 33
+
+struct cache_profile;
+
+//------------------------------------//
+//    Profile Function Prototypes     //
+//------------------------------------//
+
+// Profile 'sim' and give its levels their set counters
+// Exits with a message if the hierarchy cannot be profiled
+//
+cache_profile *profile_create(cache_sim *sim);
+
+// Release the profile of 'sim' and its set counters
+//
+void profile_free(cache_sim *sim);
+
+// Record the reuse distances of the 'n' accesses of 'batch'
+//
+void profile_batch(cache_profile *p, const mem_access *batch, size_t n);
+
+// Write the CSV header lines
+//
+void profile_sets_header(FILE *out);
+void profile_reuse_header(FILE *out);
+
+// Write the set counters, or the reuse histogram, of 'sim' as CSV rows
+// labeled 'config'
+//
+void profile_write_sets(FILE *out, const cache_sim *sim, int config);
+void profile_write_reuse(FILE *out, const cache_sim *sim, int config);
+
+#endif
@@ -0,0 +1,48 @@
+//========================================================//
+//  replace.cpp                                           //
+//  Source file for the Replacement Policies              //
+//                                                        //
+//  Policy names and the constraints each one puts on     //
+//  the associativity                                     //
+//========================================================//
+
+#include <string.h>
+#include "replace.h"
+
+static const char *policyNames[] = {
+  "lru", "plru", "srrip", "brrip", "random", "fifo"
+};
+
+int
+repl_parse(const char *name)
+{
+  for (int p = 0; p < POLICY_COUNT; p++) {
+    if (!strcmp(name, policyNames[p])) {
+      return p;
+    }
+  }
+  return -1;
+}
+
+const char *
+repl_name(uint32_t policy)
+{
+  return policy < POLICY_COUNT ? policyNames[policy] : "?";
+}
+
+const char *
+repl_check(uint32_t policy, uint32_t assoc)
+{
+  switch (policy) {
+    case POLICY_PLRU:
+      if (assoc > 64 || (assoc & (assoc - 1)))
+        return "plru needs a power of two associativity up to 64";
+      break;
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+      if (assoc > 32)
+        return "rrip keeps 2 bits per way and supports up to 32 ways";
+      break;
+  }
+  return NULL;
+}
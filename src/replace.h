@@ -0,0 +1,222 @@
+//========================================================//
+//  replace.h                                             //
+//  Header file for the Replacement Policies              //
+//                                                        //
+//  LRU, tree-PLRU, SRRIP, BRRIP, random and FIFO over    //
+//  the per-set state of a cache_level                    //
+//========================================================//
+
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include "cache.h"
+#include "tagsimd.h"
+
+//
+// Replacement State:
+// LRU     ages[way] rank, 0 is MRU and assoc-1 is LRU (see cache.h)
+// PLRU    repl[set] bit n is node n of the tree over the ways, nodes are
+//         numbered from 1 in heap order and a bit points to the half
+//         holding the victim (0 left, 1 right)
+// SRRIP   repl[set] holds a 2-bit re-reference prediction value per way,
+// BRRIP   3 is "distant" and is evicted first
+// RANDOM  no state, victims come from the level's xorshift generator
+// FIFO    repl[set] is the next way to replace
+// STAMP   repl[set*assoc+way] is the clock of the last use of the line,
+//         0 once invalidated. Skewed levels pick their own victims
+//
+// Fills always prefer an invalid way. For LRU invalid ways hold the
+// oldest ranks, the other policies look for an empty tag.
+//
+
+#define RRPV_MAX   3
+#define RRPV_LONG  2
+#define RRPV_LANES 0x5555555555555555ull   // Low bit of every 2-bit field
+
+//------------------------------------//
+//   Replacement Function Prototypes  //
+//------------------------------------//
+
+// Return the policy called 'name', or -1 if there is none
+//
+int repl_parse(const char *name);
+
+const char *repl_name(uint32_t policy);
+
+// Returns NULL if 'policy' supports 'assoc' ways, else the reason
+//
+const char *repl_check(uint32_t policy, uint32_t assoc);
+
+//------------------------------------//
+//        Replacement Helpers         //
+//------------------------------------//
+
+static inline uint32_t
+repl_random(cache_level *level)
+{
+  uint32_t x = level->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  level->rng = x;
+  return x;
+}
+
+static inline uint64_t
+rrpv_mask(uint32_t assoc)
+{
+  return assoc >= 32 ? ~0ull : (1ull << (2 * assoc)) - 1;
+}
+
+static inline void
+rrpv_set(uint64_t *state, uint32_t way, uint64_t rrpv)
+{
+  *state = (*state & ~(3ull << (2 * way))) | (rrpv << (2 * way));
+}
+
+// Point every node on the path to 'way' away from it
+//
+static inline void
+plru_touch(uint64_t *state, uint32_t assoc, uint32_t way)
+{
+  uint32_t node = 1;
+  for (uint32_t half = assoc >> 1; half; half >>= 1) {
+    uint32_t right = (way & half) != 0;
+    *state = (*state & ~(1ull << node)) | ((uint64_t)!right << node);
+    node = 2 * node + right;
+  }
+}
+
+//------------------------------------//
+//       Replacement Functions        //
+//------------------------------------//
+
+// Update the state of 'set' for a hit on 'way'
+//
+static inline void
+repl_touch(cache_level *level, uint32_t set, uint32_t way)
+{
+  switch (level->policy) {
+    case POLICY_LRU: {
+      uint16_t *ages = level->ages + (uint64_t)set * level->assoc;
+      uint16_t age = ages[way];
+      for (uint32_t i = 0; i < level->assoc; i++) {
+        ages[i] += (ages[i] < age);
+      }
+      ages[way] = 0;
+      break;
+    }
+    case POLICY_PLRU:
+      plru_touch(&level->repl[set], level->assoc, way);
+      break;
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+      rrpv_set(&level->repl[set], way, 0);
+      break;
+    case POLICY_STAMP:
+      level->repl[(uint64_t)set * level->assoc + way] = ++level->clock;
+      break;
+  }
+}
+
+// Return the way of 'set' a fill should replace
+//
+static inline uint32_t
+repl_victim(cache_level *level, uint32_t set)
+{
+  uint32_t assoc = level->assoc;
+  if (level->policy == POLICY_LRU) {
+    const uint16_t *ages = level->ages + (uint64_t)set * assoc;
+    uint32_t way;
+    for (way = 0; way < assoc; way++) {
+      if (ages[way] == assoc - 1)
+        break;
+    }
+    return way;
+  }
+
+  uint32_t empty = tag_find(level->tags + (uint64_t)set * assoc, assoc, 0,
+                            TAG_VALID);
+  if (empty < assoc) {
+    return empty;
+  }
+
+  uint64_t *state = &level->repl[set];
+  switch (level->policy) {
+    case POLICY_PLRU: {
+      uint32_t node = 1, way = 0;
+      for (uint32_t half = assoc >> 1; half; half >>= 1) {
+        uint32_t right = (*state >> node) & 1;
+        way |= right ? half : 0;
+        node = 2 * node + right;
+      }
+      return way;
+    }
+    case POLICY_SRRIP:
+    case POLICY_BRRIP: {
+      // Age every way until one becomes distant, at most RRPV_MAX times
+      uint64_t lanes = RRPV_LANES & rrpv_mask(assoc);
+      for (;;) {
+        uint64_t distant = *state & (*state >> 1) & lanes;
+        if (distant) {
+          return __builtin_ctzll(distant) / 2;
+        }
+        *state += lanes;
+      }
+    }
+    case POLICY_RANDOM:
+      return repl_random(level) % assoc;
+    case POLICY_FIFO: {
+      uint32_t way = *state;
+      *state = (way + 1) % assoc;
+      return way;
+    }
+  }
+  return 0;
+}
+
+// Update the state of 'set' for a fill of 'way'
+//
+static inline void
+repl_insert(cache_level *level, uint32_t set, uint32_t way)
+{
+  switch (level->policy) {
+    case POLICY_SRRIP:
+      rrpv_set(&level->repl[set], way, RRPV_LONG);
+      break;
+    case POLICY_BRRIP:
+      // Bimodal: distant, except for one fill in 32
+      rrpv_set(&level->repl[set], way,
+               (repl_random(level) & 31) ? RRPV_MAX : RRPV_LONG);
+      break;
+    default:
+      repl_touch(level, set, way);
+  }
+}
+
+// Update the state of 'set' for the invalidation of 'way'
+//
+static inline void
+repl_invalidate(cache_level *level, uint32_t set, uint32_t way)
+{
+  switch (level->policy) {
+    case POLICY_LRU: {
+      uint16_t *ages = level->ages + (uint64_t)set * level->assoc;
+      uint16_t age = ages[way];
+      for (uint32_t i = 0; i < level->assoc; i++) {
+        ages[i] -= (ages[i] > age);
+      }
+      ages[way] = level->assoc - 1;
+      break;
+    }
+    case POLICY_SRRIP:
+    case POLICY_BRRIP:
+      rrpv_set(&level->repl[set], way, RRPV_MAX);
+      break;
+    case POLICY_STAMP:
+      level->repl[(uint64_t)set * level->assoc + way] = 0;
+      break;
+  }
+}
+
+#endif
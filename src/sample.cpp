@@ -0,0 +1,444 @@
+//========================================================//
+//  sample.cpp                                            //
+//  Source file for the Set Sampling                      //
+//                                                        //
+//  Group filter over the accesses and per group counters //
+//  for the cluster sampling estimates                    //
+//========================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "sample.h"
+
+using namespace std;
+
+#define SAMPLE_MAX_LEVELS (3 + MAX_OUTER_LEVELS)
+#define SAMPLE_MIN_GROUPS 16  // Fewer do not show the spread of the groups
+
+//------------------------------------//
+//        Sampling Structures         //
+//------------------------------------//
+
+//
+// The counters of a sampled group are one row of 'stats': the counters of
+// the whole hierarchy, then those of each level, then the instruction
+// fetches. The whole hierarchy ones and the fetches are added per access,
+// the level ones are the change of the level counters since 'current'
+// became the group of the running accesses.
+//
+struct set_sampler {
+  uint32_t groupShift;  // Block offset bits
+  uint32_t groupMask;
+  uint32_t groups;      // Groups of the hierarchy
+  uint32_t sampled;     // Groups simulated
+  int32_t *slot;        // Row of each group, -1 if it is not sampled
+
+  uint32_t levels;
+  cache_level *level[SAMPLE_MAX_LEVELS];
+  uint32_t width;       // Counters per row
+  uint64_t *stats;
+  int32_t current;      // Row the level counters are pending for, or -1
+  uint64_t mark[SAMPLE_MAX_LEVELS * SAMPLE_COUNTERS];
+  uint64_t fetches;     // Instruction fetches of the whole trace
+
+  cache_sim *exact;     // Full run of the same hierarchy, or NULL
+};
+
+//------------------------------------//
+//         Sampling Helpers           //
+//------------------------------------//
+
+static void
+sample_error(const char *what)
+{
+  fprintf(stderr, "Set sampling %s\n", what);
+  exit(1);
+}
+
+// Scramble a group number, the sampled groups are the lowest hashes
+//
+static uint32_t
+group_hash(uint32_t g)
+{
+  g ^= g >> 16;
+  g *= 0x7feb352d;
+  g ^= g >> 15;
+  g *= 0x846ca68b;
+  g ^= g >> 16;
+  return g;
+}
+
+// Two-sided 95% quantile of the Student t distribution with 'df' degrees
+// of freedom, rounded down to a tabled one so the interval is not narrower
+//
+static double
+t_quantile(uint32_t df)
+{
+  static const struct { uint32_t df; double t; } table[] = {
+    { 1, 12.706 }, { 2, 4.303 }, { 3, 3.182 }, { 4, 2.776 }, { 5, 2.571 },
+    { 6, 2.447 }, { 7, 2.365 }, { 8, 2.306 }, { 9, 2.262 }, { 10, 2.228 },
+    { 12, 2.179 }, { 15, 2.131 }, { 20, 2.086 }, { 30, 2.042 },
+    { 60, 2.000 }, { 120, 1.980 }, { 1000, 1.962 },
+  };
+  double t = table[0].t;
+  for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+    if (table[i].df <= df) {
+      t = table[i].t;
+    }
+  }
+  return t;
+}
+
+static inline uint64_t
+counter(const cache_level *level, int c)
+{
+  return c == SAMPLE_REFS ? level->refs :
+         c == SAMPLE_MISSES ? level->misses : level->penalties;
+}
+
+// Add the level counter changes since the last mark to the current row
+//
+static void
+flush(set_sampler *s)
+{
+  if (s->current < 0) {
+    return;
+  }
+  uint64_t *row = s->stats + (uint64_t)s->current * s->width;
+  for (uint32_t i = 0; i < s->levels; i++) {
+    for (int c = 0; c < SAMPLE_COUNTERS; c++) {
+      uint32_t k = i * SAMPLE_COUNTERS + c;
+      row[SAMPLE_COUNTERS + k] += counter(s->level[i], c) - s->mark[k];
+    }
+  }
+}
+
+static void
+mark(set_sampler *s, int32_t row)
+{
+  s->current = row;
+  for (uint32_t i = 0; i < s->levels; i++) {
+    for (int c = 0; c < SAMPLE_COUNTERS; c++) {
+      s->mark[i * SAMPLE_COUNTERS + c] = counter(s->level[i], c);
+    }
+  }
+}
+
+// Return the column of 'counter' of 'level' in a row, or -1 if the
+// hierarchy has no such level
+//
+static int
+column(const set_sampler *s, const cache_level *level, int counter)
+{
+  if (!level) {
+    return counter;
+  }
+  for (uint32_t i = 0; i < s->levels; i++) {
+    if (s->level[i] == level) {
+      return (1 + i) * SAMPLE_COUNTERS + counter;
+    }
+  }
+  return -1;
+}
+
+//
+// A count is estimated as an exact part, so much per instruction fetch and
+// per data access of the trace, plus the expansion estimate of what the
+// sampled groups have beyond it. The L1 refs and the trace accesses are
+// all exact part, and every access takes at least the hit time of its
+// first level. Counts that sit in few groups, like the I-cache ones, would
+// be lost by a ratio to the trace accesses.
+//
+typedef struct {
+  int column;           // Column of the counter in a row
+  double perFetch;      // Exact part per instruction fetch
+  double perData;       // Exact part per data access
+  int exact;            // True if nothing is left to the sample
+} count_split;
+
+// Value of count 'c' of group 'g' beyond its exact part
+//
+static inline double
+residual(const set_sampler *s, uint32_t g, const count_split *c)
+{
+  const uint64_t *row = s->stats + (uint64_t)g * s->width;
+  double fetches = row[s->width - 1];
+  return row[c->column] - c->perFetch * fetches -
+         c->perData * (row[SAMPLE_REFS] - fetches);
+}
+
+// Expansion estimate of the total over all the groups of the residuals of
+// 'y' less 'ratio' times those of 'x', if not NULL. The interval is NAN,
+// unknown, if no sampled group has any
+//
+static sample_estimate
+expand(const set_sampler *s, const count_split *y, double ratio,
+       const count_split *x)
+{
+  vector<double> v(s->sampled);
+  double sum = 0;
+  int any = FALSE;
+  for (uint32_t g = 0; g < s->sampled; g++) {
+    v[g] = residual(s, g, y) - (x ? ratio * residual(s, g, x) : 0);
+    sum += v[g];
+    any = any || v[g] != 0;
+  }
+  double k = s->sampled;
+  double mean = sum / k;
+
+  double ss = 0;
+  for (uint32_t g = 0; g < s->sampled; g++) {
+    ss += (v[g] - mean) * (v[g] - mean);
+  }
+  double fpc = 1.0 - k / s->groups;
+  double var = fpc * (ss / (k - 1)) / k;
+
+  sample_estimate e;
+  e.value = mean * s->groups;
+  e.error = any ? t_quantile(s->sampled - 1) * sqrt(var) * s->groups : NAN;
+  return e;
+}
+
+// Return the level that the instruction fetches, or the data accesses,
+// reach first, or NULL if they all go to memory
+//
+static const cache_level *
+first_level(const cache_sim *sim, int fetch)
+{
+  const cache_level *l1 = fetch ? sim->ifetch : &sim->dcache;
+  if (l1->sets) {
+    return l1;
+  }
+  if (sim->l2cache.sets) {
+    return &sim->l2cache;
+  }
+  for (uint32_t i = 0; i < sim->config.outerLevels; i++) {
+    if (sim->outer[i].sets) {
+      return &sim->outer[i];
+    }
+  }
+  return NULL;
+}
+
+// Split 'counter' of 'level', NULL for the whole hierarchy, into its exact
+// part and the residual left to the sample
+//
+static count_split
+split(const cache_sim *sim, const cache_level *level, int counter)
+{
+  const cache_level *fetchLevel = first_level(sim, TRUE);
+  const cache_level *dataLevel = first_level(sim, FALSE);
+  count_split c = { column(sim->sampler, level, counter), 0, 0, FALSE };
+  if (!level && counter == SAMPLE_REFS) {
+    c.perFetch = 1;
+    c.perData = 1;
+    c.exact = TRUE;
+  } else if (!level && counter == SAMPLE_PENALTIES) {
+    uint32_t memspeed = sim->config.memspeed;
+    c.perFetch = fetchLevel ? fetchLevel->hitTime : memspeed;
+    c.perData = dataLevel ? dataLevel->hitTime : memspeed;
+  } else if (counter == SAMPLE_REFS) {
+    // The first level of a stream gets all of it, and only it if the
+    // level is an L1 or first for both streams
+    c.perFetch = fetchLevel == level;
+    c.perData = dataLevel == level;
+    c.exact = level == sim->ifetch || level == &sim->dcache ||
+              (fetchLevel == level && dataLevel == level);
+  }
+  return c;
+}
+
+static double
+exact_total(const cache_sim *sim, const count_split *c)
+{
+  const set_sampler *s = sim->sampler;
+  return c->perFetch * s->fetches +
+         c->perData * (double)(sim->totalRefs - s->fetches);
+}
+
+//------------------------------------//
+//        Sampling Functions          //
+//------------------------------------//
+
+set_sampler *
+sample_create(cache_sim *sim)
+{
+  const cache_config *c = &sim->config;
+  if (!(c->sampleSets > 0 && c->sampleSets <= 1)) {
+    sample_error("needs a fraction in (0, 1]");
+  }
+  if (c->dcache.prefetch || c->l2cache.prefetch) {
+    sample_error("does not support prefetchers, they cross set groups");
+  }
+  if (c->icache.victimEntries || c->dcache.victimEntries) {
+    sample_error("does not support victim caches, they span all sets");
+  }
+  if (c->mrcWays || c->interval || c->coherent) {
+    sample_error("does not support --mrc, --interval or multicore runs");
+  }
+
+  set_sampler *s = new set_sampler();
+  cache_level *all[SAMPLE_MAX_LEVELS] =
+      { &sim->icache, &sim->dcache, &sim->l2cache };
+  for (uint32_t i = 0; i < c->outerLevels; i++) {
+    all[3 + i] = &sim->outer[i];
+  }
+  uint32_t bits = 32;
+  for (uint32_t i = 0; i < 3 + c->outerLevels; i++) {
+    if (all[i]->fold != 31 || all[i]->skew) {
+      sample_error("needs modulo indexed levels, the groups are index bits");
+    }
+    if (all[i]->sets) {
+      s->level[s->levels++] = all[i];
+      bits = all[i]->indexBits < bits ? all[i]->indexBits : bits;
+    }
+  }
+  if (s->levels == 0 || bits == 0 || bits > 24) {
+    sample_error("needs 2 to 2^24 sets in every level");
+  }
+
+  s->groupShift = sim->blockOffsetBits;
+  s->groupMask = (1u << bits) - 1;
+  s->groups = 1u << bits;
+  s->sampled = (uint32_t)(c->sampleSets * s->groups + 0.5);
+  s->sampled = max(s->sampled, min(s->groups, (uint32_t)SAMPLE_MIN_GROUPS));
+
+  // The groups with the lowest hashes get the rows
+  vector<pair<uint32_t, uint32_t> > order;
+  for (uint32_t g = 0; g < s->groups; g++) {
+    order.push_back(make_pair(group_hash(g), g));
+  }
+  sort(order.begin(), order.end());
+  s->slot = new int32_t[s->groups];
+  memset(s->slot, 0xff, s->groups * sizeof(int32_t));
+  for (uint32_t r = 0; r < s->sampled; r++) {
+    s->slot[order[r].second] = r;
+  }
+
+  s->width = (1 + s->levels) * SAMPLE_COUNTERS + 1;
+  s->stats = new uint64_t[(uint64_t)s->sampled * s->width]();
+  s->current = -1;
+
+  if (c->sampleExact) {
+    cache_config full = *c;
+    full.sampleSets = 0;
+    full.sampleExact = FALSE;
+    s->exact = new cache_sim;
+    init_cache(s->exact, &full);
+  }
+  return s;
+}
+
+void
+sample_free(set_sampler *s)
+{
+  if (s->exact) {
+    free_cache(s->exact);
+    delete s->exact;
+  }
+  delete[] s->slot;
+  delete[] s->stats;
+  delete s;
+}
+
+uint64_t
+sample_run(cache_sim *sim, const mem_access *batch, size_t n)
+{
+  set_sampler *s = sim->sampler;
+  if (s->exact) {
+    cache_access_batch(s->exact, batch, n);
+  }
+
+  uint64_t penalties = 0;
+  for (size_t i = 0; i < n; i++) {
+    int fetch = batch[i].type == 'I';
+    s->fetches += fetch;
+    uint32_t group = (batch[i].addr >> s->groupShift) & s->groupMask;
+    int32_t row = s->slot[group];
+    if (row < 0) {
+      continue;
+    }
+    if (row != s->current) {
+      flush(s);
+      mark(s, row);
+    }
+
+    uint32_t time;
+    if (batch[i].type == 'I') {
+      time = icache_access(sim, batch[i].addr);
+    } else if (batch[i].type == 'W') {
+      time = dcache_write(sim, batch[i].addr);
+    } else {
+      time = dcache_access(sim, batch[i].addr);
+    }
+    uint64_t *stats = s->stats + (uint64_t)row * s->width;
+    stats[SAMPLE_REFS]++;
+    stats[SAMPLE_PENALTIES] += time;
+    stats[s->width - 1] += fetch;
+    penalties += time;
+  }
+  flush(s);
+  s->current = -1;
+
+  sim->totalRefs += n;
+  sim->totalPenalties += penalties;
+  return penalties;
+}
+
+void
+sample_groups(const set_sampler *s, uint32_t *sampled, uint32_t *groups)
+{
+  *sampled = s->sampled;
+  *groups = s->groups;
+}
+
+sample_estimate
+sample_count(const cache_sim *sim, const cache_level *level, int counter)
+{
+  const set_sampler *s = sim->sampler;
+  sample_estimate e = { 0, 0 };
+  count_split c = split(sim, level, counter);
+  if (c.column < 0) {
+    return e;
+  }
+  if (!c.exact) {
+    e = expand(s, &c, 0, NULL);
+  }
+  e.value += exact_total(sim, &c);
+  return e;
+}
+
+sample_estimate
+sample_ratio(const cache_sim *sim, const cache_level *level, int counter,
+             int base)
+{
+  const set_sampler *s = sim->sampler;
+  sample_estimate e = { 0, 0 };
+  count_split y = split(sim, level, counter);
+  count_split x = split(sim, level, base);
+  if (y.column < 0 || x.column < 0) {
+    return e;
+  }
+
+  // The ratio of the two estimates, with the spread of the residuals of
+  // 'y' off the ratio times those of 'x'
+  sample_estimate total = sample_count(sim, level, base);
+  if (total.value == 0) {
+    e.error = NAN;
+    return e;
+  }
+  e.value = sample_count(sim, level, counter).value / total.value;
+  if (!y.exact || !x.exact) {
+    e.error = expand(s, &y, e.value, &x).error / total.value;
+  }
+  return e;
+}
+
+cache_sim *
+sample_exact(const cache_sim *sim)
+{
+  return sim->sampler->exact;
+}
@@ -0,0 +1,79 @@
+//========================================================//
+//  sample.h                                              //
+//  Header file for the Set Sampling                      //
+//                                                        //
+//  Simulates a hashed subset of the sets and estimates   //
+//  the statistics of the full run with confidence        //
+//  intervals                                             //
+//========================================================//
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include "cache.h"
+
+//
+// Sets are sampled in groups. The group of an address is its lowest
+// index bits, as many as the level with the fewest sets has, so every
+// line of a group maps to sets of that group at every level. A sampled
+// group therefore sees all of its accesses and every sampled set, of the
+// L1s as well as of the L2 and below, behaves exactly as in a full run.
+// Accesses of the other groups are dropped before any tag array is read.
+//
+// The groups are the clusters of the estimate. The L1 refs are counted
+// exactly over the whole trace, the other counters are expansion estimates
+// of the sampled groups, with the cluster sampling variance, the finite
+// population correction and a Student t interval. Counters are attributed
+// to the group of the access that changed them, since misses, fills and
+// writebacks never leave the sets of that group. At least 16 groups are
+// sampled, fewer do not show the spread of the groups.
+//
+
+// Counters of a level, or of the whole hierarchy with a NULL level
+//
+enum { SAMPLE_REFS, SAMPLE_MISSES, SAMPLE_PENALTIES, SAMPLE_COUNTERS };
+
+typedef struct {
+  double value;         // Estimate for the full run
+  double error;         // Half width of the 95% confidence interval, NAN
+                        // if no sampled group saw the counter
+} sample_estimate;
+
+struct set_sampler;
+
+//------------------------------------//
+//    Sampling Function Prototypes    //
+//------------------------------------//
+
+// Sample 'sim' as set by its config.sampleSets
+// Exits with a message if the hierarchy cannot be sampled
+//
+set_sampler *sample_create(cache_sim *sim);
+
+void sample_free(set_sampler *s);
+
+// Run the accesses of 'batch' that fall into sampled groups
+// Returns the sum of their access times
+//
+uint64_t sample_run(cache_sim *sim, const mem_access *batch, size_t n);
+
+// Set the number of sampled groups and of all groups
+//
+void sample_groups(const set_sampler *s, uint32_t *sampled,
+                   uint32_t *groups);
+
+// Estimate 'counter' of 'level' over the whole trace
+//
+sample_estimate sample_count(const cache_sim *sim, const cache_level *level,
+                             int counter);
+
+// Estimate the ratio of 'counter' to 'base' of 'level', like miss rates
+//
+sample_estimate sample_ratio(const cache_sim *sim, const cache_level *level,
+                             int counter, int base);
+
+// The full run of the same hierarchy, or NULL without config.sampleExact
+//
+cache_sim *sample_exact(const cache_sim *sim);
+
+#endif
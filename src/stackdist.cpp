@@ -0,0 +1,176 @@
+//========================================================//
+//  stackdist.cpp                                         //
+//  Source file for the Stack Distance Engine             //
+//                                                        //
+//  Mattson's stack algorithm over per-set Fenwick trees  //
+//========================================================//
+
+#include <vector>
+#include <unordered_map>
+#include "stackdist.h"
+
+using namespace std;
+
+//------------------------------------//
+//     Stack Distance Structures      //
+//------------------------------------//
+
+//
+// Each set counts its own references as a local clock. The Fenwick tree
+// of a set holds a 1 at the time of the most recent reference to every
+// line of the set, so the LRU stack distance of a reference is the
+// number of marks after the previous reference to the same line.
+// When the clock reaches the end of the tree the live marks are
+// renumbered 1..n in order and the tree is rebuilt.
+//
+typedef struct {
+  uint32_t clock;             // Time of the latest reference
+  vector<uint32_t> tree;      // Fenwick tree over times 1..size-1
+  vector<uint32_t> lineAt;    // Line referenced at each time
+  vector<uint8_t>  live;      // Time is the latest reference to its line
+} sd_set;
+
+struct stack_dist {
+  uint32_t indexBits;
+  uint32_t offsetBits;
+  uint32_t maxWays;
+
+  vector<sd_set> sets;
+  unordered_map<uint32_t, uint32_t> lastRef; // Line -> time in its set
+  vector<uint64_t> hist;  // References per distance, maxWays is cold/far
+  uint64_t refs;
+};
+
+//------------------------------------//
+//       Fenwick Tree Functions       //
+//------------------------------------//
+
+static void
+fenwick_add(vector<uint32_t> &tree, uint32_t pos, int32_t delta)
+{
+  for (; pos < tree.size(); pos += pos & -pos) {
+    tree[pos] += delta;
+  }
+}
+
+static uint32_t
+fenwick_sum(const vector<uint32_t> &tree, uint32_t pos)
+{
+  uint32_t sum = 0;
+  for (; pos > 0; pos -= pos & -pos) {
+    sum += tree[pos];
+  }
+  return sum;
+}
+
+// Renumber the live references of 'set' and make room for new ones
+//
+static void
+compact(stack_dist *sd, sd_set *set)
+{
+  vector<uint32_t> lines;
+  for (uint32_t t = 1; t <= set->clock; t++) {
+    if (set->live[t]) {
+      lines.push_back(set->lineAt[t]);
+    }
+  }
+
+  size_t size = set->tree.size();
+  while (size < 2 * lines.size() + 64) {
+    size *= 2;
+  }
+  set->tree.assign(size, 0);
+  set->lineAt.assign(size, 0);
+  set->live.assign(size, 0);
+
+  for (uint32_t t = 1; t <= lines.size(); t++) {
+    set->lineAt[t] = lines[t - 1];
+    set->live[t] = 1;
+    set->tree[t] = 1;
+    sd->lastRef[lines[t - 1]] = t;
+  }
+  // Linear-time Fenwick build, each node adds its sum to its parent
+  for (uint32_t t = 1; t < size; t++) {
+    uint32_t parent = t + (t & -t);
+    if (parent < size) {
+      set->tree[parent] += set->tree[t];
+    }
+  }
+  set->clock = lines.size();
+}
+
+//------------------------------------//
+//     Stack Distance Functions       //
+//------------------------------------//
+
+stack_dist *
+sd_create(uint32_t indexBits, uint32_t offsetBits, uint32_t maxWays)
+{
+  stack_dist *sd = new stack_dist();
+  sd->indexBits = indexBits;
+  sd->offsetBits = offsetBits;
+  sd->maxWays = maxWays;
+  sd->sets.resize((size_t)1 << indexBits);
+  for (size_t s = 0; s < sd->sets.size(); s++) {
+    sd->sets[s].clock = 0;
+    sd->sets[s].tree.assign(64, 0);
+    sd->sets[s].lineAt.assign(64, 0);
+    sd->sets[s].live.assign(64, 0);
+  }
+  sd->hist.assign(maxWays + 1, 0);
+  sd->refs = 0;
+  return sd;
+}
+
+void
+sd_free(stack_dist *sd)
+{
+  delete sd;
+}
+
+uint32_t
+sd_access(stack_dist *sd, uint32_t addr)
+{
+  uint32_t line = addr >> sd->offsetBits;
+  sd_set *set = &sd->sets[line & ((1u << sd->indexBits) - 1)];
+  sd->refs++;
+
+  unordered_map<uint32_t, uint32_t>::iterator it = sd->lastRef.find(line);
+  uint32_t dist = SD_COLD;
+  if (it == sd->lastRef.end()) {
+    sd->hist[sd->maxWays]++;
+  } else {
+    uint32_t prev = it->second;
+    dist = fenwick_sum(set->tree, set->clock) - fenwick_sum(set->tree, prev);
+    sd->hist[dist < sd->maxWays ? dist : sd->maxWays]++;
+    fenwick_add(set->tree, prev, -1);
+    set->live[prev] = 0;
+  }
+
+  if (set->clock + 1 >= set->tree.size()) {
+    compact(sd, set);
+  }
+  uint32_t now = ++set->clock;
+  fenwick_add(set->tree, now, 1);
+  set->lineAt[now] = line;
+  set->live[now] = 1;
+  sd->lastRef[line] = now;
+  return dist;
+}
+
+uint64_t
+sd_refs(const stack_dist *sd)
+{
+  return sd->refs;
+}
+
+uint64_t
+sd_misses(const stack_dist *sd, uint32_t ways)
+{
+  uint64_t misses = 0;
+  for (uint32_t d = ways < sd->maxWays ? ways : sd->maxWays;
+       d <= sd->maxWays; d++) {
+    misses += sd->hist[d];
+  }
+  return misses;
+}
@@ -0,0 +1,44 @@
+//========================================================//
+//  stackdist.h                                           //
+//  Header file for the Stack Distance Engine             //
+//                                                        //
+//  Computes LRU miss counts for every associativity of   //
+//  a cache with a fixed number of sets in one pass       //
+//========================================================//
+
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include <stdint.h>
+
+struct stack_dist;
+
+//------------------------------------//
+//  Stack Distance Function Prototypes //
+//------------------------------------//
+
+// Create an engine for caches of 2^'indexBits' sets of 2^'offsetBits'
+// byte blocks, tracking associativities 1..'maxWays'
+//
+stack_dist *sd_create(uint32_t indexBits, uint32_t offsetBits,
+                      uint32_t maxWays);
+
+void sd_free(stack_dist *sd);
+
+#define SD_COLD 0xffffffff   // Distance of the first reference to a line
+
+// Record a reference to 'addr'
+// Returns its stack distance, the lines of its set referenced since the
+// previous reference to its line, or SD_COLD
+//
+uint32_t sd_access(stack_dist *sd, uint32_t addr);
+
+// Number of references recorded so far
+//
+uint64_t sd_refs(const stack_dist *sd);
+
+// Misses an LRU cache of 'ways' ways would have taken so far
+//
+uint64_t sd_misses(const stack_dist *sd, uint32_t ways);
+
+#endif
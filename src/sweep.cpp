@@ -0,0 +1,135 @@
+//========================================================//
+//  sweep.cpp                                             //
+//  Source file for the Sweep Engine                      //
+//                                                        //
+//  Producer/worker ring buffer over decoded accesses     //
+//========================================================//
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "sweep.h"
+
+using namespace std;
+
+//------------------------------------//
+//        Ring Buffer Structures      //
+//------------------------------------//
+
+typedef struct {
+  mem_access records[SWEEP_CHUNK];
+  size_t   count;       // Accesses in the chunk, 0 marks the end
+  uint64_t seq;         // Chunk number held by the slot
+  int      pending;     // Workers yet to finish the chunk
+} sweep_slot;
+
+typedef struct {
+  sweep_slot *slots;
+  int workers;
+  mutex lock;
+  condition_variable filled;  // Signaled when a chunk is published
+  condition_variable drained; // Signaled when a chunk is released
+} sweep_ring;
+
+//------------------------------------//
+//          Sweep Functions           //
+//------------------------------------//
+
+// Decode 'input' into the ring until the trace ends
+//
+static void
+produce(sweep_ring *ring, trace *input)
+{
+  for (uint64_t seq = 0; ; seq++) {
+    sweep_slot *slot = &ring->slots[seq % SWEEP_SLOTS];
+    {
+      unique_lock<mutex> guard(ring->lock);
+      ring->drained.wait(guard, [slot] { return slot->pending == 0; });
+    }
+
+    size_t n = trace_read(input, slot->records, SWEEP_CHUNK);
+    for (size_t i = 0; i < n; i++) {
+      char type = slot->records[i].type;
+      if (type != 'I' && type != 'D' && type != 'W') {
+        fprintf(stderr,"Input Error '%c' must be either 'I', 'D' or 'W'\n",
+                type);
+        exit(1);
+      }
+    }
+
+    {
+      lock_guard<mutex> guard(ring->lock);
+      slot->count = n;
+      slot->seq = seq;
+      slot->pending = ring->workers;
+    }
+    ring->filled.notify_all();
+    if (n == 0) {
+      return;
+    }
+  }
+}
+
+// Advance 'sims' through every chunk of the ring
+//
+static void
+consume(sweep_ring *ring, vector<cache_sim *> sims)
+{
+  for (uint64_t seq = 0; ; seq++) {
+    sweep_slot *slot = &ring->slots[seq % SWEEP_SLOTS];
+    {
+      unique_lock<mutex> guard(ring->lock);
+      ring->filled.wait(guard, [slot, seq] {
+        return slot->pending > 0 && slot->seq == seq;
+      });
+    }
+
+    size_t n = slot->count;
+    for (size_t s = 0; s < sims.size(); s++) {
+      cache_access_batch(sims[s], slot->records, n);
+    }
+
+    {
+      lock_guard<mutex> guard(ring->lock);
+      slot->pending--;
+    }
+    ring->drained.notify_all();
+    if (n == 0) {
+      return;
+    }
+  }
+}
+
+void
+sweep_run(trace *input, cache_sim **sims, int numSims, int threads)
+{
+  if (threads > numSims) {
+    threads = numSims;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  sweep_ring ring;
+  ring.slots = new sweep_slot[SWEEP_SLOTS]();
+  ring.workers = threads;
+
+  // Deal the hierarchies round-robin across the workers
+  vector<vector<cache_sim *> > shards(threads);
+  for (int s = 0; s < numSims; s++) {
+    shards[s % threads].push_back(sims[s]);
+  }
+
+  vector<thread> workers;
+  for (int w = 0; w < threads; w++) {
+    workers.push_back(thread(consume, &ring, shards[w]));
+  }
+  produce(&ring, input);
+  for (int w = 0; w < threads; w++) {
+    workers[w].join();
+  }
+
+  delete[] ring.slots;
+}
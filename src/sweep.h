@@ -0,0 +1,34 @@
+//========================================================//
+//  sweep.h                                               //
+//  Header file for the Sweep Engine                      //
+//                                                        //
+//  Drives any number of cache hierarchies through one    //
+//  read of a trace, sharded across worker threads        //
+//========================================================//
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "cache.h"
+#include "trace.h"
+
+//------------------------------------//
+//        Sweep Configuration         //
+//------------------------------------//
+
+#define SWEEP_CHUNK 65536   // Accesses per chunk of the ring buffer
+#define SWEEP_SLOTS 4       // Chunks in the ring buffer
+
+//------------------------------------//
+//      Sweep Function Prototypes     //
+//------------------------------------//
+
+// Run every hierarchy in 'sims' over the rest of 'input'
+//
+// One producer thread decodes the trace into a ring of SWEEP_SLOTS chunks
+// and 'threads' workers each advance their own share of 'sims' through
+// every chunk. A chunk is refilled once all workers are done with it
+//
+void sweep_run(trace *input, cache_sim **sims, int numSims, int threads);
+
+#endif
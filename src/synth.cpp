@@ -0,0 +1,272 @@
+//========================================================//
+//  synth.cpp                                             //
+//  Source file for the Synthetic Trace Generator         //
+//                                                        //
+//  Splitmix random numbers, rejection-inversion Zipf     //
+//  sampling and a Sattolo cycle for pointer chasing      //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "synth.h"
+
+static const char *patternNames[SYNTH_PATTERNS] =
+    { "sequential", "stride", "random", "zipf", "chase" };
+
+//------------------------------------//
+//        Generator Structures        //
+//------------------------------------//
+
+struct synth_gen {
+  synth_config config;
+  uint64_t rng;
+
+  uint64_t iThreshold;  // Fetch if the high random word is below it
+  uint64_t wThreshold;  // Write if the low random word is below it
+  uint32_t pc;          // Offset of the next fetch in the loop
+
+  uint64_t lines;       // Elements of SYNTH_ZIPF and SYNTH_CHASE
+  uint64_t column;      // First word of the current SYNTH_STRIDE column
+  uint64_t offset;      // Next word of SYNTH_SEQUENTIAL and SYNTH_STRIDE
+  uint32_t *next;       // Successor of each line on the SYNTH_CHASE cycle
+  uint32_t node;
+
+  // Rejection-inversion constants of SYNTH_ZIPF
+  double hX1;
+  double hN;
+  double s;
+};
+
+//------------------------------------//
+//         Generator Helpers          //
+//------------------------------------//
+
+static void
+synth_error(const char *what)
+{
+  fprintf(stderr, "Synthetic trace %s\n", what);
+  exit(1);
+}
+
+static inline uint64_t
+splitmix(uint64_t *s)
+{
+  uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static inline double
+uniform(uint64_t *s)
+{
+  return (splitmix(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//
+// Zipf ranks by rejection-inversion (Hormann and Derflinger), constant
+// time per sample for any number of lines and any exponent above 0
+//
+static inline double
+log1pOverX(double x)
+{
+  return fabs(x) > 1e-8 ? log1p(x) / x
+                        : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static inline double
+expm1OverX(double x)
+{
+  return fabs(x) > 1e-8 ? expm1(x) / x
+                        : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+
+static inline double
+zipfH(const synth_gen *g, double x)
+{
+  return exp(-g->config.zipf * log(x));
+}
+
+static inline double
+zipfHIntegral(const synth_gen *g, double x)
+{
+  double logX = log(x);
+  return expm1OverX((1 - g->config.zipf) * logX) * logX;
+}
+
+static inline double
+zipfHIntegralInverse(const synth_gen *g, double x)
+{
+  double t = x * (1 - g->config.zipf);
+  if (t < -1) {
+    t = -1;
+  }
+  return exp(log1pOverX(t) * x);
+}
+
+// Return a rank from 1, the most popular, to g->lines
+//
+static uint64_t
+zipfRank(synth_gen *g)
+{
+  for (;;) {
+    double u = g->hN + uniform(&g->rng) * (g->hX1 - g->hN);
+    double x = zipfHIntegralInverse(g, u);
+    double k = floor(x + 0.5);
+    if (k < 1) {
+      k = 1;
+    } else if (k > g->lines) {
+      k = g->lines;
+    }
+    if (k - x <= g->s || u >= zipfHIntegral(g, k + 0.5) - zipfH(g, k)) {
+      return (uint64_t)k;
+    }
+  }
+}
+
+// Return the offset of the next data access in the footprint
+//
+static inline uint64_t
+dataOffset(synth_gen *g)
+{
+  const synth_config *c = &g->config;
+  uint64_t off;
+  switch (c->pattern) {
+    case SYNTH_SEQUENTIAL:
+      off = g->offset;
+      g->offset = g->offset + 4 < c->footprint ? g->offset + 4 : 0;
+      return off;
+    case SYNTH_STRIDE:
+      off = g->offset;
+      g->offset += c->stride;
+      if (g->offset >= c->footprint) {
+        g->column = g->column + 4 < c->stride ? g->column + 4 : 0;
+        g->offset = g->column;
+      }
+      return off;
+    case SYNTH_RANDOM:
+      return (splitmix(&g->rng) % (c->footprint >> 2)) << 2;
+    case SYNTH_ZIPF:
+      // A multiplier prime to the line count scatters the ranks
+      return (zipfRank(g) - 1) * 2654435761ull % g->lines * c->line;
+    default:
+      g->node = g->next[g->node];
+      return (uint64_t)g->node * c->line;
+  }
+}
+
+//------------------------------------//
+//        Generator Functions         //
+//------------------------------------//
+
+void
+synth_defaults(synth_config *c)
+{
+  memset(c, 0, sizeof(*c));
+  c->pattern = SYNTH_SEQUENTIAL;
+  c->base = 0x10000000;
+  c->footprint = 64 << 20;
+  c->stride = 4096;
+  c->line = 64;
+  c->zipf = 1.0;
+  c->codeBase = 0x400000;
+  c->code = 16 << 10;
+  c->seed = 1;
+}
+
+int
+synth_pattern(const char *name)
+{
+  for (int i = 0; i < SYNTH_PATTERNS; i++) {
+    if (!strcmp(name, patternNames[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char *
+synth_name(uint32_t pattern)
+{
+  return pattern < SYNTH_PATTERNS ? patternNames[pattern] : "unknown";
+}
+
+synth_gen *
+synth_create(const synth_config *c)
+{
+  if (c->pattern >= SYNTH_PATTERNS) {
+    synth_error("pattern is unknown");
+  }
+  if (c->footprint < 4 || c->base + c->footprint > ((uint64_t)1 << 32) ||
+      c->codeBase + c->code > ((uint64_t)1 << 32)) {
+    synth_error("addresses must fit in 32 bits");
+  }
+  if (c->stride == 0 || c->stride % 4 || c->stride > c->footprint) {
+    synth_error("stride must be a multiple of 4 within the footprint");
+  }
+  if (c->line < 4 || (c->line & (c->line - 1)) || c->line > c->footprint) {
+    synth_error("line must be a power of two within the footprint");
+  }
+  if (c->code < 4 || !(c->zipf > 0) || c->ifrac < 0 || c->ifrac > 1 ||
+      c->wfrac < 0 || c->wfrac > 1) {
+    synth_error("needs code of 4 bytes or more, a positive Zipf exponent "
+                "and fractions in [0, 1]");
+  }
+
+  synth_gen *g = new synth_gen();
+  g->config = *c;
+  g->config.code &= ~3u;
+  g->rng = c->seed;
+  g->iThreshold = (uint64_t)(c->ifrac * 4294967296.0);
+  g->wThreshold = (uint64_t)(c->wfrac * 4294967296.0);
+  g->lines = c->footprint / c->line;
+
+  if (c->pattern == SYNTH_ZIPF) {
+    g->hX1 = zipfHIntegral(g, 1.5) - 1;
+    g->hN = zipfHIntegral(g, g->lines + 0.5);
+    g->s = 2 - zipfHIntegralInverse(g, zipfHIntegral(g, 2.5) - zipfH(g, 2));
+  }
+  if (c->pattern == SYNTH_CHASE) {
+    if (g->lines > UINT32_MAX) {
+      synth_error("chase needs fewer than 2^32 lines");
+    }
+    // Sattolo's shuffle makes a single cycle through every line
+    g->next = new uint32_t[g->lines];
+    for (uint64_t i = 0; i < g->lines; i++) {
+      g->next[i] = (uint32_t)i;
+    }
+    for (uint64_t i = g->lines - 1; i > 0; i--) {
+      uint64_t j = splitmix(&g->rng) % i;
+      uint32_t t = g->next[i];
+      g->next[i] = g->next[j];
+      g->next[j] = t;
+    }
+  }
+  return g;
+}
+
+void
+synth_free(synth_gen *g)
+{
+  delete[] g->next;
+  delete g;
+}
+
+void
+synth_fill(synth_gen *g, mem_access *out, size_t n)
+{
+  const synth_config *c = &g->config;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t r = splitmix(&g->rng);
+    if ((r >> 32) < g->iThreshold) {
+      out[i].addr = (uint32_t)(c->codeBase + g->pc);
+      out[i].type = 'I';
+      g->pc = g->pc + 4 < c->code ? g->pc + 4 : 0;
+    } else {
+      out[i].addr = (uint32_t)(c->base + dataOffset(g));
+      out[i].type = (r & 0xffffffff) < g->wThreshold ? 'W' : 'D';
+    }
+  }
+}
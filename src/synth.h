@@ -0,0 +1,77 @@
+//========================================================//
+//  synth.h                                               //
+//  Header file for the Synthetic Trace Generator         //
+//                                                        //
+//  Streams accesses of parameterized patterns, used by   //
+//  cache-gen and the benchmark driver                    //
+//========================================================//
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include "trace.h"
+
+//
+// Data patterns, over 'footprint' bytes from 'base':
+//   sequential  word after word, wrapping around
+//   stride      words 'stride' bytes apart, then the next column, as a
+//               column-major walk of a row-major array
+//   random      uniform words
+//   zipf        lines by Zipf popularity with exponent 'zipf', the hot
+//               lines scattered over the footprint
+//   chase       lines along one random cycle through all of them, as
+//               pointer chasing a shuffled linked list
+//
+// A fraction 'ifrac' of the accesses are instruction fetches, word after
+// word through a loop of 'code' bytes, and a fraction 'wfrac' of the data
+// accesses are writes.
+//
+enum {
+  SYNTH_SEQUENTIAL,
+  SYNTH_STRIDE,
+  SYNTH_RANDOM,
+  SYNTH_ZIPF,
+  SYNTH_CHASE,
+  SYNTH_PATTERNS
+};
+
+typedef struct {
+  uint32_t pattern;
+  uint64_t base;        // Lowest data address
+  uint64_t footprint;   // Bytes of data
+  uint32_t stride;      // Bytes between the accesses of SYNTH_STRIDE
+  uint32_t line;        // Bytes of a SYNTH_ZIPF or SYNTH_CHASE element
+  double   zipf;        // Exponent of SYNTH_ZIPF
+  double   ifrac;       // Fraction of instruction fetches
+  double   wfrac;       // Fraction of the data accesses that are writes
+  uint64_t codeBase;    // Lowest instruction address
+  uint32_t code;        // Bytes of the instruction loop
+  uint64_t seed;
+} synth_config;
+
+struct synth_gen;
+
+//------------------------------------//
+//   Generator Function Prototypes    //
+//------------------------------------//
+
+void synth_defaults(synth_config *c);
+
+// Return the pattern called 'name', -1 if there is none
+//
+int synth_pattern(const char *name);
+
+const char *synth_name(uint32_t pattern);
+
+// Start the stream of 'c'
+// Exits with a message if the parameters are out of range
+//
+synth_gen *synth_create(const synth_config *c);
+
+void synth_free(synth_gen *g);
+
+// Write the next 'n' accesses of the stream to 'out'
+//
+void synth_fill(synth_gen *g, mem_access *out, size_t n);
+
+#endif
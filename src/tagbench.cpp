@@ -0,0 +1,92 @@
+//========================================================//
+//  tagbench.cpp                                          //
+//  Microbenchmark for the SIMD Tag Search                //
+//                                                        //
+//  Lookup throughput of tag_find against the scalar      //
+//  loop for associativities 1 to 16                      //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "tagsimd.h"
+
+using namespace std;
+
+#define SETS    1024
+#define PROBES  (1 << 22)
+#define ROUNDS  8
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+xorshift(uint32_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+template <bool Simd>
+static double
+measure(const vector<uint32_t> &tags, const vector<uint32_t> &sets,
+        const vector<uint32_t> &probes, uint32_t assoc, uint64_t *sum)
+{
+  double best = 1e30;
+  for (int r = 0; r < ROUNDS; r++) {
+    double start = now();
+    uint64_t s = 0;
+    for (size_t i = 0; i < probes.size(); i++) {
+      const uint32_t *ways = &tags[sets[i] * assoc];
+      s += Simd ? tag_find_simd(ways, assoc, probes[i], ~0u)
+                : tag_find_scalar(ways, assoc, probes[i], ~0u);
+    }
+    double t = now() - start;
+    best = t < best ? t : best;
+    *sum = s;
+  }
+  return probes.size() / best / 1e6;
+}
+
+int
+main()
+{
+  static const uint32_t assocs[] = { 1, 2, 4, 8, 16, 32 };
+  printf("%-6s %14s %14s %8s\n", "Assoc", "Scalar Ml/s", "SIMD Ml/s", "Speedup");
+
+  for (size_t a = 0; a < sizeof(assocs) / sizeof(assocs[0]); a++) {
+    uint32_t assoc = assocs[a];
+    uint32_t seed = 12345;
+    vector<uint32_t> tags(SETS * assoc + TAG_PAD);
+    for (size_t i = 0; i < SETS * assoc; i++) {
+      tags[i] = (xorshift(&seed) << 1) | 1;
+    }
+
+    // Half hits spread over all ways, half misses
+    vector<uint32_t> sets(PROBES), probes(PROBES);
+    for (size_t i = 0; i < PROBES; i++) {
+      sets[i] = xorshift(&seed) % SETS;
+      uint32_t way = xorshift(&seed) % assoc;
+      probes[i] = (xorshift(&seed) & 1) ? tags[sets[i] * assoc + way] : 0;
+    }
+
+    uint64_t scalarSum, simdSum;
+    double scalar = measure<false>(tags, sets, probes, assoc, &scalarSum);
+    double simd = measure<true>(tags, sets, probes, assoc, &simdSum);
+    if (scalarSum != simdSum) {
+      fprintf(stderr, "Mismatch at assoc %u\n", assoc);
+      return 1;
+    }
+    printf("%-6u %14.1f %14.1f %7.2fx\n", assoc, scalar, simd, simd / scalar);
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+//========================================================//
+//  tagsimd.h                                             //
+//  Header file for the SIMD Tag Search                   //
+//                                                        //
+//  Compares a whole set of masked tags against a probe   //
+//  with AVX2 or SSE2 and+compare+movemask, scalar        //
+//  otherwise                                             //
+//========================================================//
+
+#ifndef TAGSIMD_H
+#define TAGSIMD_H
+
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Tag arrays are padded by this many entries so the vector loads of the
+// last set stay inside the allocation
+//
+#define TAG_PAD 8
+
+// Below this associativity the early-exit scalar loop wins on real traces,
+// where hits are frequent and predictable
+//
+#define TAG_SIMD_MIN 8
+
+//------------------------------------//
+//        Tag Search Functions        //
+//------------------------------------//
+
+// Return the first of the 'assoc' entries of 'ways' equal to 'probe' once
+// ANDed with 'mask', or assoc if there is none. Masking out the flags
+// that do not identify the line finds it in one probe whatever they are
+//
+static inline uint32_t
+tag_find_scalar(const uint32_t *ways, uint32_t assoc, uint32_t probe,
+                uint32_t mask)
+{
+  uint32_t way;
+  for (way = 0; way < assoc; way++) {
+    if ((ways[way] & mask) == probe)
+      break;
+  }
+  return way;
+}
+
+#if defined(__AVX2__)
+#define TAG_VECTOR 8
+#elif defined(__SSE2__)
+#define TAG_VECTOR 4
+#endif
+
+#ifdef TAG_VECTOR
+// Bit w of the result is set if (ways[w] & mask) == probe, for
+// w < TAG_VECTOR
+//
+static inline uint32_t
+tag_match(const uint32_t *ways, uint32_t probe, uint32_t mask)
+{
+#if defined(__AVX2__)
+  __m256i t = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)ways),
+                               _mm256_set1_epi32(mask));
+  return _mm256_movemask_ps(
+      _mm256_castsi256_ps(_mm256_cmpeq_epi32(t, _mm256_set1_epi32(probe))));
+#else
+  __m128i t = _mm_and_si128(_mm_loadu_si128((const __m128i *)ways),
+                            _mm_set1_epi32(mask));
+  return _mm_movemask_ps(
+      _mm_castsi128_ps(_mm_cmpeq_epi32(t, _mm_set1_epi32(probe))));
+#endif
+}
+#endif
+
+static inline uint32_t
+tag_find_simd(const uint32_t *ways, uint32_t assoc, uint32_t probe,
+              uint32_t mask)
+{
+#ifdef TAG_VECTOR
+  // A sentinel bit at 'assoc' turns "no match" into ctz() == assoc,
+  // so sets of up to four vectors are searched without a branch
+  if (assoc <= TAG_VECTOR) {
+    uint32_t hits = tag_match(ways, probe, mask) & ((1u << assoc) - 1);
+    return __builtin_ctz(hits | (1u << assoc));
+  } else if (assoc <= 2 * TAG_VECTOR) {
+    uint32_t hits = tag_match(ways, probe, mask) |
+                    tag_match(ways + TAG_VECTOR, probe, mask) << TAG_VECTOR;
+    hits &= (1u << assoc) - 1;
+    return __builtin_ctz(hits | (1u << assoc));
+  } else if (assoc <= 4 * TAG_VECTOR) {
+    uint64_t hits = tag_match(ways, probe, mask) |
+        (uint64_t)tag_match(ways + TAG_VECTOR, probe, mask) << TAG_VECTOR |
+        (uint64_t)tag_match(ways + 2 * TAG_VECTOR, probe, mask) <<
+            2 * TAG_VECTOR |
+        (uint64_t)tag_match(ways + 3 * TAG_VECTOR, probe, mask) <<
+            3 * TAG_VECTOR;
+    uint64_t sentinel = (uint64_t)1 << assoc;
+    return __builtin_ctzll((hits & (sentinel - 1)) | sentinel);
+  }
+
+  for (uint32_t w = 0; w < assoc; w += TAG_VECTOR) {
+    uint32_t hits = tag_match(ways + w, probe, mask);
+    if (assoc - w < TAG_VECTOR) {
+      hits &= (1u << (assoc - w)) - 1;
+    }
+    if (hits) {
+      return w + __builtin_ctz(hits);
+    }
+  }
+  return assoc;
+#else
+  return tag_find_scalar(ways, assoc, probe, mask);
+#endif
+}
+
+static inline uint32_t
+tag_find(const uint32_t *ways, uint32_t assoc, uint32_t probe, uint32_t mask)
+{
+  if (assoc < TAG_SIMD_MIN) {
+    return tag_find_scalar(ways, assoc, probe, mask);
+  }
+  return tag_find_simd(ways, assoc, probe, mask);
+}
+
+#endif
@@ -0,0 +1,268 @@
+//========================================================//
+//  timing.cpp                                            //
+//  Source file for the Timing Model                      //
+//                                                        //
+//  In-order issue over per-level MSHR heaps and a        //
+//  memory return slot                                    //
+//========================================================//
+
+#include <stdio.h>
+#include <string.h>
+#include "timing.h"
+
+//------------------------------------//
+//         Timing Structures          //
+//------------------------------------//
+
+typedef struct {
+  uint64_t ready;       // Cycle the fill completes
+  uint32_t line;
+} mshr_entry;
+
+// MSHRs of one level, a min-heap on ready. Entries whose fill completed
+// are free but stay in the heap until a miss takes their place
+//
+typedef struct {
+  mshr_entry heap[TIMING_MAX_MSHRS];
+  uint32_t size;
+  uint32_t limit;       // MSHRs of the level, 0 blocks the core
+} mshr_file;
+
+struct cache_timing {
+  mshr_file ifile;      // I$, the D$ one for a unified L1
+  mshr_file dfile;
+  mshr_file l2file;
+  cache_level *memLevel;    // Level whose misses read memory
+  uint32_t memInterval;
+  uint64_t now;         // Cycle the next access issues
+  uint64_t last;        // Latest completion
+  uint64_t memFree;     // First cycle memory can return another line
+  timing_stats stats;
+};
+
+//------------------------------------//
+//          Timing Helpers            //
+//------------------------------------//
+
+static void
+timing_error(const char *what)
+{
+  fprintf(stderr, "The timing model %s\n", what);
+  exit(1);
+}
+
+// Return the fill of 'line' in flight at 'cycle' in 'f', or NULL
+//
+static inline const mshr_entry *
+mshrFind(const mshr_file *f, uint32_t line, uint64_t cycle)
+{
+  for (uint32_t i = 0; i < f->size; i++) {
+    if (f->heap[i].line == line && f->heap[i].ready > cycle) {
+      return &f->heap[i];
+    }
+  }
+  return NULL;
+}
+
+// Return the first cycle from 'cycle' on that 'f' has a free MSHR
+//
+static inline uint64_t
+mshrFree(const mshr_file *f, uint32_t limit, uint64_t cycle)
+{
+  if (f->size < limit || f->heap[0].ready <= cycle) {
+    return cycle;
+  }
+  return f->heap[0].ready;
+}
+
+// Take an MSHR of 'f' for the fill of 'line' completing at 'ready', in
+// place of the one that frees first once the file is full
+//
+static void
+mshrTake(mshr_file *f, uint32_t limit, uint32_t line, uint64_t ready)
+{
+  mshr_entry e = { ready, line };
+  uint32_t i;
+  if (f->size < limit) {
+    // Sift up from the new leaf
+    for (i = f->size++; i > 0 && f->heap[(i - 1) / 2].ready > ready;
+         i = (i - 1) / 2) {
+      f->heap[i] = f->heap[(i - 1) / 2];
+    }
+  } else {
+    // Sift down from the root
+    for (i = 0; 2 * i + 1 < f->size; ) {
+      uint32_t c = 2 * i + 1;
+      if (c + 1 < f->size && f->heap[c + 1].ready < f->heap[c].ready) {
+        c++;
+      }
+      if (f->heap[c].ready >= ready) {
+        break;
+      }
+      f->heap[i] = f->heap[c];
+      i = c;
+    }
+  }
+  f->heap[i] = e;
+}
+
+static void
+mshrInit(mshr_file *f, uint32_t limit)
+{
+  if (limit > TIMING_MAX_MSHRS) {
+    timing_error("supports up to 64 MSHRs per level");
+  }
+  memset(f, 0, sizeof(*f));
+  f->limit = limit;
+}
+
+// Place an L1 miss of 'line' issued at t->now with the access time 'time',
+// moving t->now on to the cycle it gets its MSHR
+// Returns the cycle its fill completes
+//
+static inline uint64_t
+timeMiss(cache_sim *sim, cache_timing *t, mshr_file *f, uint32_t line,
+         uint32_t time, int l2miss, int memRead)
+{
+  cache_level *l1 = f == &t->dfile ? &sim->dcache : sim->ifetch;
+  uint64_t start = t->now;
+  if (f->limit) {
+    start = mshrFree(f, f->limit, t->now);
+    t->stats.mshrStalls += start - t->now;
+    t->now = start;
+  }
+  uint64_t ready = start + time;
+
+  if (sim->l2cache.sets) {
+    mshr_file *l2 = &t->l2file;
+    uint32_t limit = l2->limit ? l2->limit : 1;
+    uint64_t arrive = start + l1->hitTime;
+    if (l2miss) {
+      uint64_t free = mshrFree(l2, limit, arrive);
+      t->stats.l2Stalls += free - arrive;
+      ready += free - arrive;
+    } else {
+      // A line the L2 is still filling arrives with that fill
+      const mshr_entry *e = mshrFind(l2, line, arrive);
+      if (e) {
+        t->stats.merged++;
+        ready = e->ready > ready ? e->ready : ready;
+      }
+    }
+  }
+
+  if (memRead && t->memInterval) {
+    if (ready < t->memFree) {
+      t->stats.memStalls += t->memFree - ready;
+      ready = t->memFree;
+    }
+    t->memFree = ready + t->memInterval;
+  }
+
+  if (f->limit) {
+    mshrTake(f, f->limit, line, ready);
+  }
+  if (l2miss) {
+    mshrTake(&t->l2file, t->l2file.limit ? t->l2file.limit : 1, line,
+             ready);
+  }
+  return ready;
+}
+
+//------------------------------------//
+//         Timing Functions           //
+//------------------------------------//
+
+cache_timing *
+timing_create(cache_sim *sim)
+{
+  const cache_config *c = &sim->config;
+  if (c->coherent || c->sampleSets) {
+    timing_error("does not support --sample-sets or multicore runs");
+  }
+  if (!sim->ifetch->sets || !sim->dcache.sets) {
+    timing_error("needs an I-cache, or a unified L1, and a D-cache");
+  }
+
+  cache_timing *t = new cache_timing();
+  mshrInit(&t->ifile, c->unified ? c->dcache.mshrs : c->icache.mshrs);
+  mshrInit(&t->dfile, c->dcache.mshrs);
+  mshrInit(&t->l2file, c->l2cache.mshrs);
+  t->memInterval = c->memInterval;
+  if (c->outerLevels) {
+    t->memLevel = &sim->outer[c->outerLevels - 1];
+  } else if (sim->l2cache.sets) {
+    t->memLevel = &sim->l2cache;
+  }
+  return t;
+}
+
+void
+timing_free(cache_timing *t)
+{
+  delete t;
+}
+
+uint64_t
+timing_run(cache_sim *sim, const mem_access *batch, size_t n)
+{
+  cache_timing *t = sim->timing;
+  cache_level *l2 = &sim->l2cache;
+  uint32_t offset = sim->blockOffsetBits;
+  int posted = sim->config.noWriteAllocate;
+  uint64_t penalties = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    int fetch = batch[i].type == 'I';
+    cache_level *l1 = fetch ? sim->ifetch : &sim->dcache;
+    mshr_file *f = fetch && !sim->config.unified ? &t->ifile : &t->dfile;
+    cache_level *mem = t->memLevel ? t->memLevel : l1;
+    uint64_t l1misses = l1->misses;
+    uint64_t l2misses = l2->misses;
+    uint64_t memMisses = mem->misses;
+
+    uint32_t time;
+    if (fetch) {
+      time = icache_access(sim, batch[i].addr);
+    } else if (batch[i].type == 'W') {
+      time = dcache_write(sim, batch[i].addr);
+    } else {
+      time = dcache_access(sim, batch[i].addr);
+    }
+    penalties += time;
+
+    uint32_t line = batch[i].addr >> offset;
+    uint64_t ready;
+    if (l1->misses == l1misses) {
+      ready = t->now + time;
+      const mshr_entry *e = f->limit ? mshrFind(f, line, t->now) : NULL;
+      if (e) {
+        t->stats.merged++;
+        ready = e->ready > ready ? e->ready : ready;
+      }
+      t->now = fetch ? ready : t->now + time;
+    } else if (posted && batch[i].type == 'W') {
+      // A write around the L1 leaves through the write buffer
+      ready = t->now + time;
+      t->now += l1->hitTime;
+    } else {
+      ready = timeMiss(sim, t, f, line, time, l2->misses != l2misses,
+                       mem->misses != memMisses);
+      t->now = fetch || !f->limit ? ready : t->now + l1->hitTime;
+    }
+    t->last = ready > t->last ? ready : t->last;
+  }
+
+  sim->totalRefs += n;
+  sim->totalPenalties += penalties;
+  return penalties;
+}
+
+timing_stats
+timing_report(const cache_sim *sim)
+{
+  const cache_timing *t = sim->timing;
+  timing_stats s = t->stats;
+  s.cycles = t->last > t->now ? t->last : t->now;
+  return s;
+}
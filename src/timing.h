@@ -0,0 +1,69 @@
+//========================================================//
+//  timing.h                                              //
+//  Header file for the Timing Model                      //
+//                                                        //
+//  Estimates the cycles of a run with non-blocking       //
+//  caches: MSHRs, merged misses and a memory bandwidth   //
+//  limit                                                 //
+//========================================================//
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "cache.h"
+
+//
+// The functional simulation gives every access its unloaded access time,
+// the sum the statistics report. The timing model lays those times out on
+// a cycle axis. The core issues the accesses in order, one every L1 hit
+// time. An L1 miss takes an MSHR of its L1 until its fill completes, its
+// access time later, and the core goes on: the trace has no dependences,
+// so data misses overlap as far as the MSHRs allow. Instruction fetches
+// wait for their line, and a level with 0 MSHRs blocks on every miss.
+//
+// A hit on a line whose fill is still in flight merges into that MSHR and
+// completes with the fill. L1 misses that miss the L2 also take an L2 MSHR
+// (at least one) and wait for one to free. Lines read from memory return
+// at most one every config.memInterval cycles.
+//
+// Each MSHR file is the event queue of the fills of its level: a binary
+// min-heap on the completion cycle, whose top is the next MSHR to free.
+// Only misses touch it.
+//
+// With 0 MSHRs at both L1s and no bandwidth limit the estimate is the
+// serialized sum, Total Memory penalties.
+//
+
+#define TIMING_MAX_MSHRS 64
+
+typedef struct {
+  uint64_t cycles;      // Estimated cycles of the accesses
+  uint64_t merged;      // Misses merged into a fill in flight
+  uint64_t mshrStalls;  // Cycles the core waited for an L1 MSHR
+  uint64_t l2Stalls;    // Cycles L1 misses waited for an L2 MSHR
+  uint64_t memStalls;   // Cycles fills waited for memory bandwidth
+} timing_stats;
+
+struct cache_timing;
+
+//------------------------------------//
+//     Timing Function Prototypes     //
+//------------------------------------//
+
+// Time 'sim' as set by its config.timing
+// Exits with a message if the hierarchy cannot be timed
+//
+cache_timing *timing_create(cache_sim *sim);
+
+void timing_free(cache_timing *t);
+
+// Run the accesses of 'batch' and place them on the cycle axis
+// Returns the sum of their access times
+//
+uint64_t timing_run(cache_sim *sim, const mem_access *batch, size_t n);
+
+// Return the statistics of the accesses timed so far
+//
+timing_stats timing_report(const cache_sim *sim);
+
+#endif
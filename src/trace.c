@@ -0,0 +1,536 @@
+//========================================================//
+//  trace.c                                               //
+//  Source file for the Trace Reader                      //
+//                                                        //
+//  Text traces are parsed line by line, binary traces    //
+//  are memory-mapped and decoded without any parsing     //
+//========================================================//
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "decoder.h"
+
+//------------------------------------//
+//        Binary Trace Helpers        //
+//------------------------------------//
+
+static uint64_t
+raw_payload(uint64_t count, uint32_t version)
+{
+  uint64_t bitmap = (count + 7) / 8;
+  return count * sizeof(uint32_t) + (version > 1 ? 2 * bitmap : bitmap);
+}
+
+// Return the compressed address of 'addr' in the address space 'asid'
+//
+static inline uint32_t
+compress(trace *t, uint64_t addr, uint32_t asid)
+{
+  uint64_t region = addr >> t->regionBits;
+  trace_region *r = &t->recent[(region ^ asid) & (TRACE_REGIONS - 1)];
+  if (r->region != region || r->asid != asid) {
+    if (!t->regions) {
+      fprintf(stderr, "Input Error 0x%lx in address space %u needs more "
+              "than 32 bits\n", addr, asid);
+      exit(1);
+    }
+    r->region = region;
+    r->asid = asid;
+    r->base = (uint32_t)((uint64_t)addr_map_region(t->regions, asid, addr)
+                         << t->regionBits);
+  }
+  return r->base | (uint32_t)(addr & t->regionMask);
+}
+
+static char
+record_type(uint32_t isData, uint32_t isWrite)
+{
+  return isWrite ? 'W' : isData ? 'D' : 'I';
+}
+
+// Map 't->stream' if it is a binary trace
+//
+// Returns True if the stream was mapped
+//
+static int
+map_binary(trace *t)
+{
+  struct stat st;
+  int fd = fileno(t->stream);
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+      (size_t)st.st_size < sizeof(trace_header)) {
+    return 0;
+  }
+
+  trace_header hdr;
+  if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+      memcmp(hdr.magic, TRACE_MAGIC, 4)) {
+    return 0;
+  }
+
+  uint64_t avail = st.st_size - sizeof(hdr);
+  if (hdr.version < 1 || hdr.version > TRACE_VERSION ||
+      hdr.payload > avail ||
+      (hdr.encoding == TRACE_RAW &&
+       raw_payload(hdr.count, hdr.version) > hdr.payload) ||
+      hdr.encoding > TRACE_DELTA) {
+    fprintf(stderr, "Corrupt or unsupported binary trace\n");
+    exit(1);
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  t->map = (uint8_t *)map;
+  t->mapLen = st.st_size;
+  t->version = hdr.version;
+  t->encoding = hdr.encoding;
+  t->count = hdr.count;
+  t->addrs = (const uint32_t *)(t->map + sizeof(hdr));
+  t->types = t->map + sizeof(hdr) + hdr.count * sizeof(uint32_t);
+  if (hdr.version > 1) {
+    t->writes = t->types + (hdr.count + 7) / 8;
+  }
+  t->cursor = t->map + sizeof(hdr);
+  return 1;
+}
+
+static size_t
+read_raw(trace *t, mem_access *out, size_t max)
+{
+  uint64_t left = t->count - t->pos;
+  size_t n = left < max ? left : max;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t pos = t->pos + i;
+    out[i].addr = compress(t, t->addrs[pos], 0);
+    out[i].type = (t->types[pos >> 3] >> (pos & 7)) & 1 ? 'D' : 'I';
+  }
+  if (t->writes) {
+    for (size_t i = 0; i < n; i++) {
+      uint64_t pos = t->pos + i;
+      if ((t->writes[pos >> 3] >> (pos & 7)) & 1) {
+        out[i].type = 'W';
+      }
+    }
+  }
+  t->pos += n;
+  return n;
+}
+
+static size_t
+read_delta(trace *t, mem_access *out, size_t max)
+{
+  const uint8_t *end = t->map + t->mapLen;
+  const uint8_t *p = t->cursor;
+  uint32_t kindBits = t->version > 1 ? 2 : 1;
+  size_t n = 0;
+  for (; n < max && t->pos < t->count; n++, t->pos++) {
+    uint64_t v = 0;
+    int shift = 0;
+    do {
+      if (p == end || shift > 35) {
+        fprintf(stderr, "Corrupt binary trace at record %lu\n", t->pos);
+        exit(1);
+      }
+      v |= (uint64_t)(*p & 0x7f) << shift;
+      shift += 7;
+    } while (*p++ & 0x80);
+
+    uint32_t isData = v & 1;
+    uint32_t isWrite = (v >> 1) & (kindBits - 1);
+    uint32_t zz = v >> kindBits;
+    int32_t delta = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+    t->prev[isData] += delta;
+    out[n].addr = compress(t, t->prev[isData], 0);
+    out[n].type = record_type(isData, isWrite);
+  }
+  t->cursor = p;
+  return n;
+}
+
+//------------------------------------//
+//        Text Trace Helpers          //
+//------------------------------------//
+
+static const uint8_t *
+hex_table()
+{
+  static uint8_t table[256];
+  static int ready = 0;
+  if (!ready) {
+    memset(table, 0xff, sizeof(table));
+    for (int c = 0; c < 10; c++) table['0' + c] = c;
+    for (int c = 0; c < 6; c++) table['a' + c] = table['A' + c] = 10 + c;
+    ready = 1;
+  }
+  return table;
+}
+
+// Exit with the number and the text of the line [p, end) that does not
+// parse
+//
+static void
+bad_line(const trace *t, const char *p, const char *end)
+{
+  int len = end - p > 80 ? 80 : (int)(end - p);
+  fprintf(stderr, "Input Error line %lu: '%.*s%s' is not "
+          "\"0x<address> I|D|W [asid]\"\n", t->lineNo, len, p,
+          end - p > len ? "..." : "");
+  exit(1);
+}
+
+// Parse the line [p, end) as "0x<addr> <type> [asid]"
+// Exits with a message if the line does not parse
+//
+// Returns False for a blank line
+//
+static int
+parse_line(trace *t, const char *p, const char *end, mem_access *out)
+{
+  const uint8_t *hex = hex_table();
+  const char *line = p;
+  t->lineNo++;
+  while (end > p && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) {
+    end--;
+  }
+  if (p == end) {
+    return 0;
+  }
+
+  if (end - p < 3 || p[0] != '0' || (p[1] != 'x' && p[1] != 'X') ||
+      hex[(uint8_t)p[2]] == 0xff) {
+    bad_line(t, line, end);
+  }
+
+  uint64_t addr = 0;
+  for (p += 2; p < end && hex[(uint8_t)*p] != 0xff; p++) {
+    addr = (addr << 4) | hex[(uint8_t)*p];
+  }
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    p++;
+  }
+  if (p == end || (*p != 'I' && *p != 'D' && *p != 'W')) {
+    bad_line(t, line, end);
+  }
+  out->type = *p++;
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    p++;
+  }
+  uint32_t asid = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    asid = asid * 10 + (*p - '0');
+  }
+  out->addr = compress(t, addr, asid);
+  return 1;
+}
+
+static void
+carry_append(trace *t, const char *p, size_t n)
+{
+  if (t->carryLen + n > t->carryCap) {
+    t->carryCap = (t->carryLen + n) * 2;
+    t->carry = (char *)realloc(t->carry, t->carryCap);
+  }
+  memcpy(t->carry + t->carryLen, p, n);
+  t->carryLen += n;
+}
+
+static size_t
+read_text(trace *t, mem_access *out, size_t max)
+{
+  size_t n = 0;
+  while (n < max && !t->eof) {
+    if (t->blockPos == t->blockLen) {
+      if (t->block) {
+        decoder_release(t->decoder);
+      }
+      t->blockLen = decoder_next(t->decoder, &t->block);
+      t->blockPos = 0;
+      if (t->blockLen == 0) {
+        // Last line without a newline
+        t->eof = 1;
+        n += parse_line(t, t->carry, t->carry + t->carryLen, &out[n]);
+        t->carryLen = 0;
+        break;
+      }
+    }
+
+    const char *p = t->block + t->blockPos;
+    const char *end = t->block + t->blockLen;
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    if (!nl) {
+      carry_append(t, p, end - p);
+      t->blockPos = t->blockLen;
+      continue;
+    }
+
+    if (t->carryLen) {
+      carry_append(t, p, nl - p);
+      n += parse_line(t, t->carry, t->carry + t->carryLen, &out[n]);
+      t->carryLen = 0;
+    } else {
+      n += parse_line(t, p, nl, &out[n]);
+    }
+    t->blockPos = nl + 1 - t->block;
+  }
+  return n;
+}
+
+// Encode 'v' at 'out', returns the byte after it
+//
+static uint8_t *
+put_varint(uint8_t *out, uint64_t v)
+{
+  while (v >= 0x80) {
+    *out++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *out++ = v;
+  return out;
+}
+
+//------------------------------------//
+//          Trace Functions           //
+//------------------------------------//
+
+int
+trace_open(trace *t, const char *path)
+{
+  memset(t, 0, sizeof(*t));
+  trace_set_regions(t, NULL);
+  t->left = UINT64_MAX;
+  t->stream = path ? fopen(path, "r") : stdin;
+  if (!t->stream) {
+    return 0;
+  }
+
+  if (map_binary(t)) {
+    fclose(t->stream);
+    t->stream = NULL;
+  } else {
+    // Build the table here, text traces may be parsed on several threads
+    hex_table();
+    t->decoder = decoder_start(t->stream);
+  }
+  return 1;
+}
+
+size_t
+trace_read(trace *t, mem_access *out, size_t max)
+{
+  if (max > t->left) {
+    max = t->left;
+  }
+  size_t n;
+  if (t->map) {
+    n = t->encoding == TRACE_RAW ? read_raw(t, out, max)
+                                 : read_delta(t, out, max);
+  } else {
+    n = read_text(t, out, max);
+  }
+  t->left -= n;
+  return n;
+}
+
+uint64_t
+trace_skip(trace *t, uint64_t n)
+{
+  // RAW traces only hold 32-bit addresses of asid 0, which compress to
+  // themselves, so the skipped ones need not be read
+  if (t->map && t->encoding == TRACE_RAW) {
+    uint64_t left = t->count - t->pos;
+    n = n < left ? n : left;
+    n = n < t->left ? n : t->left;
+    t->pos += n;
+    t->left -= n;
+    return n;
+  }
+
+  mem_access scratch[4096];
+  uint64_t skipped = 0;
+  while (skipped < n) {
+    uint64_t want = n - skipped < 4096 ? n - skipped : 4096;
+    size_t got = trace_read(t, scratch, want);
+    if (got == 0) {
+      break;
+    }
+    skipped += got;
+  }
+  return skipped;
+}
+
+void
+trace_set_limit(trace *t, uint64_t n)
+{
+  t->left = n;
+}
+
+void
+trace_set_regions(trace *t, addr_map *map)
+{
+  t->regions = map;
+  t->regionBits = map ? addr_map_bits(map) : 32;
+  t->regionMask = ((uint64_t)1 << t->regionBits) - 1;
+
+  // Without a map, 32-bit addresses of asid 0 are their own compression
+  for (int i = 0; i < TRACE_REGIONS; i++) {
+    t->recent[i].region = map ? ~(uint64_t)0 : 0;
+    t->recent[i].asid = 0;
+    t->recent[i].base = 0;
+  }
+}
+
+void
+trace_close(trace *t)
+{
+  if (t->map) {
+    munmap(t->map, t->mapLen);
+  }
+  if (t->decoder) {
+    decoder_stop(t->decoder);
+  }
+  if (t->stream) {
+    fclose(t->stream);
+  }
+  free(t->carry);
+  memset(t, 0, sizeof(*t));
+}
+
+int
+trace_convert(trace *in, const char *path, uint32_t encoding)
+{
+  trace_writer *w = trace_writer_open(path, encoding);
+  if (!w) {
+    perror(path);
+    return 0;
+  }
+
+  mem_access batch[4096];
+  size_t n;
+  int ok = 1;
+  while (ok && (n = trace_read(in, batch, 4096))) {
+    ok = trace_write(w, batch, n);
+  }
+  return trace_writer_close(w) && ok;
+}
+
+//------------------------------------//
+//       Binary Trace Writer          //
+//------------------------------------//
+
+struct trace_writer {
+  FILE *out;
+  char *path;
+  trace_header hdr;
+  uint32_t prev[2];     // Previous I and D addresses for DELTA
+
+  uint8_t *types;       // RAW bitmaps, written after the addresses
+  uint8_t *writes;
+  size_t typesCap;
+  uint8_t *buf;         // Encoded batch
+  size_t bufCap;
+};
+
+trace_writer *
+trace_writer_open(const char *path, uint32_t encoding)
+{
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    return NULL;
+  }
+
+  trace_writer *w = (trace_writer *)calloc(1, sizeof(trace_writer));
+  w->out = out;
+  w->path = strdup(path);
+  memcpy(w->hdr.magic, TRACE_MAGIC, 4);
+  w->hdr.version = TRACE_VERSION;
+  w->hdr.encoding = encoding;
+  fwrite(&w->hdr, sizeof(w->hdr), 1, out);
+  return w;
+}
+
+int
+trace_write(trace_writer *w, const mem_access *batch, size_t n)
+{
+  // A varint of DELTA takes at most 5 bytes
+  if (n * 5 > w->bufCap) {
+    w->bufCap = n * 5;
+    w->buf = (uint8_t *)realloc(w->buf, w->bufCap);
+  }
+  uint64_t last = w->hdr.count + n - 1;
+  if (w->hdr.encoding == TRACE_RAW && n && (last >> 3) >= w->typesCap) {
+    size_t old = w->typesCap;
+    w->typesCap = w->typesCap ? w->typesCap : 4096;
+    while ((last >> 3) >= w->typesCap) {
+      w->typesCap *= 2;
+    }
+    w->types = (uint8_t *)realloc(w->types, w->typesCap);
+    w->writes = (uint8_t *)realloc(w->writes, w->typesCap);
+    memset(w->types + old, 0, w->typesCap - old);
+    memset(w->writes + old, 0, w->typesCap - old);
+  }
+
+  uint32_t *addrs = (uint32_t *)w->buf;
+  uint8_t *p = w->buf;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t pos = w->hdr.count + i;
+    uint32_t addr = batch[i].addr;
+    char type = batch[i].type;
+    if (type != 'I' && type != 'D' && type != 'W') {
+      fprintf(stderr,"Input Error '%c' must be either 'I', 'D' or 'W'\n",
+              type);
+      return 0;
+    }
+    uint32_t isData = type != 'I';
+    uint32_t isWrite = type == 'W';
+
+    if (w->hdr.encoding == TRACE_RAW) {
+      addrs[i] = addr;
+      w->types[pos >> 3] |= isData << (pos & 7);
+      w->writes[pos >> 3] |= isWrite << (pos & 7);
+    } else {
+      int32_t delta = (int32_t)(addr - w->prev[isData]);
+      uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+      p = put_varint(p, ((uint64_t)zz << 2) | isWrite << 1 | isData);
+      w->prev[isData] = addr;
+    }
+  }
+  size_t len = w->hdr.encoding == TRACE_RAW ? n * sizeof(uint32_t)
+                                            : (size_t)(p - w->buf);
+  fwrite(w->buf, 1, len, w->out);
+  w->hdr.count += n;
+  return 1;
+}
+
+int
+trace_writer_close(trace_writer *w)
+{
+  if (w->hdr.encoding == TRACE_RAW) {
+    fwrite(w->types, 1, (w->hdr.count + 7) / 8, w->out);
+    fwrite(w->writes, 1, (w->hdr.count + 7) / 8, w->out);
+  }
+  w->hdr.payload = ftell(w->out) - sizeof(w->hdr);
+  fseek(w->out, 0, SEEK_SET);
+  fwrite(&w->hdr, sizeof(w->hdr), 1, w->out);
+
+  int ok = 1;
+  if (fclose(w->out)) {
+    perror(w->path);
+    ok = 0;
+  }
+  free(w->types);
+  free(w->writes);
+  free(w->buf);
+  free(w->path);
+  free(w);
+  return ok;
+}
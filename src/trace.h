@@ -0,0 +1,165 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for the Trace Reader                      //
+//                                                        //
+//  Reads memory access traces either as text lines       //
+//  ("0x<addr> <I|D|W> [asid]"), optionally bzip2/gzip/   //
+//  zstd compressed, or in the compact binary format      //
+//  written by 'cache --convert'                          //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include "addrmap.h"
+
+//------------------------------------//
+//        Binary Trace Format         //
+//------------------------------------//
+//
+// header:  trace_header (32 bytes)
+// RAW:     uint32_t addr[count], then a bitmap of count bits (1 = D or W),
+//          then a bitmap of count bits (1 = W)
+// DELTA:   count LEB128 varints, each
+//          (zigzag(addr - prev) << 2) | isWrite << 1 | isData,
+//          where prev is the previous address of the same I/D stream
+//
+// Version 1 traces have no write bitmap and a 1-bit type in the varints,
+// they are still read. Binary traces hold 32-bit addresses of asid 0
+//
+#define TRACE_MAGIC   "CTRC"
+#define TRACE_VERSION 2
+
+#define TRACE_RAW     0
+#define TRACE_DELTA   1
+
+typedef struct {
+  char     magic[4];
+  uint32_t version;
+  uint32_t encoding;
+  uint32_t reserved;
+  uint64_t count;       // Number of records
+  uint64_t payload;     // Payload size in bytes
+} trace_header;
+
+//------------------------------------//
+//          Trace Structures          //
+//------------------------------------//
+
+typedef struct {
+  uint32_t addr;        // Address of the access, compressed (addrmap.h)
+  char     type;        // 'I', 'D' (data read) or 'W' (data write)
+} mem_access;
+
+#define TRACE_REGIONS 16    // Regions whose compressed base is cached
+
+typedef struct {
+  uint64_t region;      // Address bits above the region bits
+  uint32_t asid;
+  uint32_t base;        // Compressed address of the region
+} trace_region;
+
+struct trace_decoder;
+
+typedef struct {
+  // Text input
+  FILE    *stream;
+  struct trace_decoder *decoder;  // Background decompression/read thread
+  const char *block;    // Decoded bytes being parsed
+  size_t   blockLen;
+  size_t   blockPos;
+  char    *carry;       // Line split across two blocks
+  size_t   carryLen;
+  size_t   carryCap;
+  int      eof;
+  uint64_t lineNo;      // Lines parsed, for the error messages
+
+  // Binary input
+  uint8_t *map;         // Mapping of the whole file
+  size_t   mapLen;
+  uint32_t version;
+  uint32_t encoding;
+  uint64_t count;       // Number of records
+  uint64_t pos;         // Next record to read
+  const uint32_t *addrs;
+  const uint8_t  *types;
+  const uint8_t  *writes;   // NULL for version 1
+  const uint8_t  *cursor;
+  uint32_t prev[2];     // Previous I and D addresses for DELTA
+
+  // Address compression
+  struct addr_map *regions; // Map of the wide addresses, or NULL
+  uint32_t regionBits;
+  uint64_t regionMask;
+  trace_region recent[TRACE_REGIONS];
+
+  uint64_t left;        // Accesses left before the trace is cut short
+} trace;
+
+//------------------------------------//
+//     Trace Function Prototypes      //
+//------------------------------------//
+
+// Open the trace at 'path', or stdin if 'path' is NULL
+// Binary traces are detected by their magic and memory-mapped, text
+// traces are read and decompressed on a background thread
+//
+// Returns True if Successful
+//
+int trace_open(trace *t, const char *path);
+
+// Read up to 'max' accesses into 'out'
+// Returns the number of accesses read, 0 at the end of the trace
+//
+size_t trace_read(trace *t, mem_access *out, size_t max);
+
+// Drop the next 'n' accesses of 't', a RAW binary trace just seeks
+// Returns the number of accesses dropped, less than 'n' at the end
+//
+uint64_t trace_skip(trace *t, uint64_t n);
+
+// End 't' after its next 'n' accesses
+//
+void trace_set_limit(trace *t, uint64_t n);
+
+// Compress the addresses of 't' with 'map', which may be shared by
+// several traces. Without a map, addresses above 4 GB or with an asid
+// are an input error
+//
+void trace_set_regions(trace *t, struct addr_map *map);
+
+void trace_close(trace *t);
+
+// Write every remaining access of 'in' to the binary trace 'path'
+//
+// Returns True if Successful
+//
+int trace_convert(trace *in, const char *path, uint32_t encoding);
+
+//------------------------------------//
+//         Binary Trace Writer        //
+//------------------------------------//
+
+typedef struct trace_writer trace_writer;
+
+// Create the binary trace 'path' with 'encoding'
+// Returns NULL with errno set if the file cannot be created
+//
+trace_writer *trace_writer_open(const char *path, uint32_t encoding);
+
+// Append the 'n' accesses of 'batch'
+//
+// Returns True if Successful
+//
+int trace_write(trace_writer *w, const mem_access *batch, size_t n);
+
+// Complete the header and close the trace
+//
+// Returns True if Successful
+//
+int trace_writer_close(trace_writer *w);
+
+#endif